@@ -276,6 +276,8 @@ class App extends Component {
     if (data) {
       this.checkpoint.data = data;
       this.checkpoint.time = Date.now();
+      // The binary file written by the standalone trainer no longer matches the data
+      delete this.checkpoint.file;
       this.saveCheckpoint(() => {
         console.log("Save checkpoint at " + steps + "/" + this.state.config.totalSteps);
       });
@@ -0,0 +1,15 @@
+
+#include "Benchmark.h"
+
+Benchmark::Benchmark(const String &filter, double sampleTime, int sampleCount)
+    : filter(filter)
+    , sampleTime(sampleTime)
+    , sampleCount(sampleCount) {
+  if (sampleCount < 1) {
+    EXCEPT("Sample count must be positive");
+  }
+}
+
+bool Benchmark::selected(const String &name) const {
+  return filter.empty() || (name.find(filter) != String::npos);
+}
@@ -0,0 +1,65 @@
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "Types.h"
+
+#include <algorithm>
+
+class Benchmark {
+public:
+  struct Result {
+    String name;
+    long long iterations;
+    double medianTime;
+    double minimumTime;
+  };
+
+  Benchmark(const String &filter, double sampleTime, int sampleCount);
+
+  bool selected(const String &name) const;
+
+  template<typename Function>
+  void run(const String &name, Function function);
+
+  Array<Result> results;
+
+private:
+  String filter;
+  double sampleTime;
+  int sampleCount;
+};
+
+template<typename Function>
+void Benchmark::run(const String &name, Function function) {
+  if (!selected(name)) {
+    return;
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  const auto measure = [&function](long long iterations) {
+    const auto startTime = Clock::now();
+    for (long long i = 0; i < iterations; i++) {
+      function();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - startTime).count();
+  };
+
+  function();
+
+  long long iterations = 1;
+  while (measure(iterations) < sampleTime * 1e9) {
+    iterations *= 2;
+  }
+
+  Array<double> times(sampleCount);
+  for (auto &time : times) {
+    time = measure(iterations) / iterations;
+  }
+  std::sort(times.begin(), times.end());
+
+  results.push_back({name, iterations, times[times.size() / 2], times.front()});
+  std::cout << name << ": " << results.back().medianTime << " ns" << std::endl;
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,43 @@
+
+#include "ShapeFixtures.h"
+
+static const float linkSpacing = 2.2;
+static const float linkHeight = 1;
+static const float prismSpacing = 1.5;
+static const float prismMass = 1;
+static const float jointAngle = 60;
+static const float jointPower = 10;
+
+// Hinge axis along z: the joint frame x axis is rotated onto the world z axis
+static const char *jointOrientation = "0 -0.7071068 0 0.7071068";
+
+String chainShapeData(int linkCount, int prismsPerLink) {
+  if (linkCount < 1) {
+    EXCEPT("Chain must have links");
+  }
+  if (prismsPerLink < 1) {
+    EXCEPT("Link must have prisms");
+  }
+
+  std::ostringstream stream;
+  stream << "o chain" << linkCount << "x" << prismsPerLink << "\n";
+  for (int i = 0; i < linkCount; i++) {
+    const auto mass = prismMass * prismsPerLink;
+    const auto inertia = mass / 6;
+    stream << "l " << mass << " "
+           << inertia << " " << inertia << " " << inertia << " "
+           << i * linkSpacing << " " << linkHeight << " 0 0 0 0 1\n";
+    for (int j = 0; j < prismsPerLink; j++) {
+      const auto offset = (j - 0.5f * (prismsPerLink - 1)) * prismSpacing;
+      stream << "p 0 0 " << offset << " 0 0 0 1\n";
+    }
+  }
+  for (int i = 0; i + 1 < linkCount; i++) {
+    stream << "j " << i << " " << i + 1 << " "
+           << -jointAngle << " " << jointAngle << " " << jointPower << " "
+           << (i + 0.5f) * linkSpacing << " " << linkHeight << " 0 "
+           << jointOrientation << "\n";
+  }
+  stream << "b " << linkCount / 2;
+  return stream.str();
+}
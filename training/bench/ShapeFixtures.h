@@ -0,0 +1,9 @@
+
+#ifndef SHAPEFIXTURES_H
+#define SHAPEFIXTURES_H
+
+#include "Types.h"
+
+String chainShapeData(int linkCount, int prismsPerLink = 1);
+
+#endif // SHAPEFIXTURES_H
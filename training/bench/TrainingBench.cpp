@@ -0,0 +1,696 @@
+
+#include "Types.h"
+#include "Config.h"
+#include "TwistyEnv.h"
+#include "PrismShape.h"
+#include "Network.h"
+#include "ActorKernel.h"
+#include "ParameterKernel.h"
+#include "ReplayBuffer.h"
+#include "ReplayCodec.h"
+#include "ReplayCodecKernel.h"
+#include "Base64.h"
+#include "Benchmark.h"
+#include "ShapeFixtures.h"
+
+#define RAPIDJSON_HAS_STDSTRING 1
+#include "rapidjson/document.h"
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+static const std::array<int, 5> linkCounts = {2, 4, 8, 16, 32};
+static const std::array<int, 3> physicsThreadCounts = {2, 4, 8};
+static const std::array<int, 3> batchSizes = {64, 256, 1024};
+static const std::array<IntArray, 2> hiddenLayerSizes = {{{64, 64}, {256, 256}}};
+static const int replayLinkCount = 8;
+static const int replayCapacity = 1000000;
+static const int replayBatchSize = 256;
+static const int trainBufferSize = 10000;
+static const int supportDirectionCount = 1024;
+static const float supportTolerance = 1e-5;
+static const int restoreStepCount = 200;
+static const int kernelCheckCount = 100;
+static const float kernelTolerance = 1e-4;
+static const int collisionLinkCount = 8;
+static const int collisionStepCount = 50;
+static const float dropTilt = 0.2;
+static const float trajectoryTolerance = 0.05;
+static const float contactTolerance = 0.05;
+static const float normalTolerance = 1e-4;
+
+static volatile float sink;
+
+static String hiddenName(const IntArray &sizes) {
+  String name;
+  for (const auto size : sizes) {
+    name += (name.empty() ? "" : "x") + std::to_string(size);
+  }
+  return name;
+}
+
+static void stepEnvironment(Environment &environment, const Action &action) {
+  if (environment.done || environment.timeout()) {
+    environment.restart();
+  }
+  sink = environment.step(action);
+}
+
+static void randomize(Array<float> &values, RandomGenerator &randomGenerator) {
+  std::uniform_real_distribution<float> distribution(-1, 1);
+  for (auto &value : values) {
+    value = distribution(randomGenerator);
+  }
+}
+
+static void fillReplayBuffer(ReplayBuffer &replayBuffer, int count,
+                             int observationLength, int actionLength,
+                             RandomGenerator &randomGenerator) {
+  std::uniform_real_distribution<float> rewardDistribution(-1, 1);
+  Array<float> observation(observationLength);
+  Array<float> action(actionLength);
+  Array<float> nextObservation(observationLength);
+  randomize(observation, randomGenerator);
+  for (int i = 0; i < count; i++) {
+    const auto done = ((i % 1000) == 999);
+    randomize(action, randomGenerator);
+    randomize(nextObservation, randomGenerator);
+    replayBuffer.append(0, observation.data(), action.data(), rewardDistribution(randomGenerator),
+                        nextObservation.data(), done);
+    if (done) {
+      randomize(observation, randomGenerator);
+    } else {
+      observation.swap(nextObservation);
+    }
+  }
+}
+
+// Rewards followed by observations of an episode played from a fixed seed.
+static Array<float> playEpisode(Environment &environment, const Array<Action> &actions) {
+  environment.randomGenerator = std::make_shared<RandomGenerator>(0);
+  environment.restart();
+  Array<float> trace;
+  for (const auto &action : actions) {
+    if (environment.done) {
+      break;
+    }
+    trace.push_back(environment.step(action));
+    const auto &observation = environment.observation;
+    trace.insert(trace.end(), std::begin(observation), std::end(observation));
+  }
+  return trace;
+}
+
+// The first episode builds the world, the second one starts from the restored snapshot.
+static void checkRestore(int linkCount) {
+  TwistyEnv environment(chainShapeData(linkCount));
+  RandomGenerator randomGenerator(0);
+  Array<Action> actions(restoreStepCount, Action(0.0, environment.actionLength));
+  std::uniform_real_distribution<float> distribution(-1, 1);
+  for (auto &action : actions) {
+    for (auto &value : action) {
+      value = distribution(randomGenerator);
+    }
+  }
+
+  const auto builtTrace = playEpisode(environment, actions);
+  const auto restoredTrace = playEpisode(environment, actions);
+  const auto traceBytes = builtTrace.size() * sizeof(float);
+  if ((builtTrace.size() != restoredTrace.size()) ||
+      (std::memcmp(builtTrace.data(), restoredTrace.data(), traceBytes) != 0)) {
+    EXCEPT("Restored world diverges from the built one (links: " +
+           std::to_string(linkCount) + ")");
+  }
+}
+
+static void benchEnvironment(Benchmark &benchmark) {
+  for (const auto linkCount : linkCounts) {
+    const auto suffix = "/links:" + std::to_string(linkCount);
+    checkRestore(linkCount);
+
+    TwistyEnv environment(chainShapeData(linkCount));
+    environment.restart();
+    const auto action = environment.randomAction();
+    benchmark.run("TwistyEnv::step" + suffix, [&]() {
+      stepEnvironment(environment, action);
+    });
+    benchmark.run("Environment::restart" + suffix, [&]() {
+      environment.restart();
+    });
+
+    PhysicsConfig multiBodyConfig;
+    multiBodyConfig.backend = PhysicsBackend::MultiBody;
+    TwistyEnv multiBodyEnvironment(chainShapeData(linkCount), multiBodyConfig);
+    multiBodyEnvironment.restart();
+    benchmark.run("TwistyEnv::step" + suffix + "/multiBody", [&]() {
+      stepEnvironment(multiBodyEnvironment, action);
+    });
+  }
+}
+
+// Thread counts run in increasing order because the shared task pool only grows.
+static void benchPhysicsThreads(Benchmark &benchmark) {
+#if BT_THREADSAFE
+  for (const auto threadCount : physicsThreadCounts) {
+    for (const auto linkCount : linkCounts) {
+      const auto baseName = "TwistyEnv::step/links:" + std::to_string(linkCount);
+      const auto name = baseName + "/threads:" + std::to_string(threadCount);
+      if (!benchmark.selected(name)) {
+        continue;
+      }
+
+      PhysicsConfig physicsConfig;
+      physicsConfig.threadCount = threadCount;
+      TwistyEnv environment(chainShapeData(linkCount), physicsConfig);
+      environment.restart();
+      const auto action = environment.randomAction();
+      benchmark.run(name, [&]() {
+        stepEnvironment(environment, action);
+      });
+
+      const auto baseResult = std::find_if(benchmark.results.begin(), benchmark.results.end(),
+                                           [&baseName](const Benchmark::Result &result) {
+                                             return (result.name == baseName);
+                                           });
+      if (baseResult != benchmark.results.end()) {
+        const auto speedup = baseResult->medianTime / benchmark.results.back().medianTime;
+        std::cout << name << ": speedup " << speedup << std::endl;
+      }
+    }
+  }
+#endif
+}
+
+static void benchNetwork(Benchmark &benchmark) {
+  TwistyEnv environment(chainShapeData(replayLinkCount));
+  environment.restart();
+  const int observationLength = environment.observation.size();
+  const int actionLength = environment.actionLength;
+  RandomGenerator randomGenerator(0);
+
+  for (const auto &sizes : hiddenLayerSizes) {
+    const auto hidden = "/hidden:" + hiddenName(sizes);
+    Config config;
+    config.hiddenLayerSizes = sizes;
+    config.replayBufferSize = trainBufferSize;
+
+    Network network(config, observationLength, actionLength);
+    const auto observation = environment.observation;
+    benchmark.run("Network::predict" + hidden, [&]() {
+      sink = network.predict(observation)[0];
+    });
+    const auto parameterSuffix = hidden + "/" + ParameterKernel::instructionSet();
+    benchmark.run("FusedAdam::step" + parameterSuffix, [&]() {
+      network.criticOptimizer.step();
+    });
+    benchmark.run("ParameterArena::interpolate" + parameterSuffix, [&]() {
+      network.targetCriticParameters.interpolate(network.criticParameters, config.interpolation);
+    });
+
+    for (const auto batchSize : batchSizes) {
+      config.batchSize = batchSize;
+      Network trainNetwork(config, observationLength, actionLength);
+      ReplayBuffer replayBuffer(config, observationLength, actionLength);
+      fillReplayBuffer(replayBuffer, trainBufferSize, observationLength, actionLength,
+                       randomGenerator);
+      auto &batch = replayBuffer.sampleBatch();
+      benchmark.run("Network::train/batch:" + std::to_string(batchSize) + hidden, [&]() {
+        sink = trainNetwork.train(batch).second;
+      });
+    }
+  }
+}
+
+// Also checks the packed actor kernel against the torch forward pass on random inputs.
+static void benchActorKernel(Benchmark &benchmark) {
+  TwistyEnv environment(chainShapeData(replayLinkCount));
+  const int observationLength = environment.observation.size();
+  const int actionLength = environment.actionLength;
+  RandomGenerator randomGenerator(0);
+  torch::manual_seed(0);
+  torch::NoGradGuard noGradGuard;
+
+  for (const auto &sizes : hiddenLayerSizes) {
+    const auto hidden = "/hidden:" + hiddenName(sizes);
+    Actor actor(sizes, observationLength, actionLength);
+    ActorKernel actorKernel(actor);
+    Array<float> observation(observationLength);
+    Array<float> action(actionLength);
+    const auto input = torch::from_blob(observation.data(), {1, observationLength});
+
+    float maximumError = 0;
+    for (int i = 0; i < kernelCheckCount; i++) {
+      randomize(observation, randomGenerator);
+      const auto expected = actor.forward(input).contiguous();
+      const auto *expectedData = expected.data_ptr<float>();
+      actorKernel.forward(observation.data(), action.data());
+      for (int j = 0; j < actionLength; j++) {
+        maximumError = std::max(maximumError, std::abs(action[j] - expectedData[j]));
+      }
+    }
+    std::cout << "ActorKernel::forward" << hidden << ": maximum error " << maximumError
+              << " (" << DenseKernel::instructionSet() << ")" << std::endl;
+    if (!(maximumError <= kernelTolerance)) {
+      EXCEPT("Actor kernel differs from the torch forward pass");
+    }
+
+    benchmark.run("ActorKernel::forward" + hidden, [&]() {
+      actorKernel.forward(observation.data(), action.data());
+      sink = action[0];
+    });
+    benchmark.run("Actor::forward" + hidden, [&]() {
+      sink = actor.forward(input).data_ptr<float>()[0];
+    });
+  }
+}
+
+static void benchReplayBuffer(Benchmark &benchmark, bool prioritized,
+                              ObservationFormat observationFormat = ObservationFormat::Float32,
+                              ActionFormat actionFormat = ActionFormat::Float32,
+                              const String &formatName = "") {
+  const String variant = (prioritized ? "/prioritized" : "/uniform") + formatName;
+  if (!benchmark.selected("ReplayBuffer::append" + variant) &&
+      !benchmark.selected("ReplayBuffer::sampleBatch" + variant)) {
+    return;
+  }
+
+  TwistyEnv environment(chainShapeData(replayLinkCount));
+  const int observationLength = environment.observation.size();
+  const int actionLength = environment.actionLength;
+  RandomGenerator randomGenerator(0);
+
+  Config config;
+  config.replayBufferSize = replayCapacity;
+  config.prioritizedReplay = prioritized;
+  config.batchSize = replayBatchSize;
+  config.replayObservationFormat = observationFormat;
+  config.replayActionFormat = actionFormat;
+  ReplayBuffer replayBuffer(config, observationLength, actionLength);
+
+  Array<float> observation(observationLength);
+  Array<float> action(actionLength);
+  randomize(observation, randomGenerator);
+  randomize(action, randomGenerator);
+  benchmark.run("ReplayBuffer::append" + variant, [&]() {
+    replayBuffer.append(0, observation.data(), action.data(), 1, observation.data(), false);
+  });
+
+  fillReplayBuffer(replayBuffer, replayCapacity - replayBuffer.size,
+                   observationLength, actionLength, randomGenerator);
+  benchmark.run("ReplayBuffer::sampleBatch" + variant, [&]() {
+    auto &batch = replayBuffer.sampleBatch();
+    if (prioritized) {
+      batch.tdError.uniform_(0, 1);
+      replayBuffer.updatePriorities(batch);
+    }
+    sink = batch.reward.data_ptr<float>()[0];
+  });
+}
+
+static void benchReplayCodec(Benchmark &benchmark) {
+  const int length = replayBatchSize * 32;
+  RandomGenerator randomGenerator(0);
+  Array<float> values(length);
+  randomize(values, randomGenerator);
+  Array<char> data(length * sizeof(float));
+  Array<float> decoded(length);
+  const auto suffix = "/values:" + std::to_string(length) + "/" +
+                      ReplayCodecKernel::instructionSet();
+
+  const std::array<std::pair<ObservationFormat, const char*>, 3> observationFormats = {{
+    {ObservationFormat::Float32, "float32"},
+    {ObservationFormat::Float16, "float16"},
+    {ObservationFormat::BFloat16, "bfloat16"}
+  }};
+  for (const auto &observationFormat : observationFormats) {
+    const auto format = observationFormat.first;
+    const auto *name = observationFormat.second;
+    ReplayCodec::encode(format, values.data(), length, data.data());
+    benchmark.run(String("ReplayCodec::decode/") + name + suffix, [&]() {
+      ReplayCodec::decode(format, data.data(), length, decoded.data());
+      sink = decoded[0];
+    });
+  }
+
+  const std::array<std::pair<ActionFormat, const char*>, 2> actionFormats = {{
+    {ActionFormat::Int16, "int16"},
+    {ActionFormat::Int8, "int8"}
+  }};
+  for (const auto &actionFormat : actionFormats) {
+    const auto format = actionFormat.first;
+    const auto *name = actionFormat.second;
+    ReplayCodec::encode(format, values.data(), length, data.data());
+    benchmark.run(String("ReplayCodec::decode/") + name + suffix, [&]() {
+      ReplayCodec::decode(format, data.data(), length, decoded.data());
+      sink = decoded[0];
+    });
+  }
+}
+
+// Also checks that the analytic prism support mapping matches a hull of the same vertices.
+static void benchPrismShape(Benchmark &benchmark) {
+  TwistyEnv environment(chainShapeData(1));
+  const auto *prismShape = static_cast<const PrismShape*>(environment.shape->prismShape);
+  btConvexHullShape hullShape;
+  hullShape.setMargin(prismShape->getMargin());
+  for (const auto &vertex : prismShape->vertices) {
+    hullShape.addPoint(vertex, false);
+  }
+  hullShape.recalcLocalAabb();
+
+  RandomGenerator randomGenerator(0);
+  std::normal_distribution<float> distribution;
+  Array<btVector3> directions(supportDirectionCount);
+  for (auto &direction : directions) {
+    direction = btVector3(distribution(randomGenerator), distribution(randomGenerator),
+                          distribution(randomGenerator)).normalized();
+    const auto prismSupport = prismShape->localGetSupportingVertex(direction).dot(direction);
+    const auto hullSupport = hullShape.localGetSupportingVertex(direction).dot(direction);
+    if (std::abs(prismSupport - hullSupport) > supportTolerance) {
+      EXCEPT("Prism support mapping differs from hull");
+    }
+  }
+
+  benchmark.run("PrismShape::localGetSupportingVertex", [&]() {
+    for (const auto &direction : directions) {
+      sink = prismShape->localGetSupportingVertex(direction).x();
+    }
+  });
+  benchmark.run("btConvexHullShape::localGetSupportingVertex", [&]() {
+    for (const auto &direction : directions) {
+      sink = hullShape.localGetSupportingVertex(direction).x();
+    }
+  });
+}
+
+struct GroundContact {
+  btVector3 point;
+  btVector3 normal; // from the ground towards the body
+  btScalar distance;
+};
+
+// The hull compounds of the former collision path, with the same child transforms.
+struct HullShapes {
+  HullShapes(const TwistyShape &shape) {
+    const auto *prismShape = static_cast<const PrismShape*>(shape.prismShape);
+    hullShape.setMargin(prismShape->getMargin());
+    for (const auto &vertex : prismShape->vertices) {
+      hullShape.addPoint(vertex, false);
+    }
+    hullShape.recalcLocalAabb();
+    for (const auto *linkShape : shape.linkShapes) {
+      auto hullLinkShape = std::make_unique<btCompoundShape>();
+      for (int i = 0; i < linkShape->getNumChildShapes(); i++) {
+        hullLinkShape->addChildShape(linkShape->getChildTransform(i), &hullShape);
+      }
+      linkShapes.push_back(hullLinkShape.get());
+      compoundShapes.push_back(std::move(hullLinkShape));
+    }
+  }
+
+  btConvexHullShape hullShape;
+  std::vector<std::unique_ptr<btCompoundShape>> compoundShapes;
+  std::vector<btCollisionShape*> linkShapes;
+};
+
+// Bodies are removed and added back in the same order for both shapes, so that both
+// worlds keep the same object order.
+static void setLinkShapes(TwistyEnv &environment,
+                          const std::vector<btCollisionShape*> &linkShapes) {
+  std::vector<std::pair<int, int>> filters;
+  for (auto *body : environment.bodies) {
+    const auto *proxy = body->getBroadphaseHandle();
+    filters.emplace_back(proxy->m_collisionFilterGroup, proxy->m_collisionFilterMask);
+    environment.dynamicsWorld->removeRigidBody(body);
+  }
+  for (int i = 0; i < environment.bodies.size(); i++) {
+    auto *body = environment.bodies[i];
+    body->setCollisionShape(linkShapes[i]);
+    environment.dynamicsWorld->addRigidBody(body, filters[i].first, filters[i].second);
+  }
+}
+
+static Array<GroundContact> groundContacts(const TwistyEnv &environment) {
+  Array<GroundContact> contacts;
+  const auto *dispatcher = environment.dispatcher;
+  for (int i = 0; i < dispatcher->getNumManifolds(); i++) {
+    const auto *manifold = dispatcher->getManifoldByIndexInternal(i);
+    const auto groundFirst = (manifold->getBody0() == environment.groundObject);
+    if (!groundFirst && (manifold->getBody1() != environment.groundObject)) {
+      continue;
+    }
+    for (int j = 0; j < manifold->getNumContacts(); j++) {
+      const auto &point = manifold->getContactPoint(j);
+      contacts.push_back({groundFirst ? point.getPositionWorldOnA() : point.getPositionWorldOnB(),
+                          groundFirst ? -point.m_normalWorldOnB : point.m_normalWorldOnB,
+                          point.getDistance()});
+    }
+  }
+  return contacts;
+}
+
+// Every penetrating hull contact needs a prism contact nearby with the same normal, and the
+// deepest penetrations must agree. Contacts near the breaking threshold are left out, as
+// either path may keep them for a step longer.
+static void compareContacts(const Array<GroundContact> &hullContacts,
+                            const Array<GroundContact> &prismContacts, const String &name) {
+  btScalar hullDepth = 0;
+  btScalar prismDepth = 0;
+  for (const auto &contact : prismContacts) {
+    prismDepth = std::min(prismDepth, contact.distance);
+  }
+  for (const auto &hullContact : hullContacts) {
+    hullDepth = std::min(hullDepth, hullContact.distance);
+    if (hullContact.distance >= 0) {
+      continue;
+    }
+    const auto match = std::any_of(prismContacts.begin(), prismContacts.end(),
+                                   [&hullContact](const GroundContact &prismContact) {
+      return (prismContact.point.distance(hullContact.point) <= contactTolerance) &&
+             (prismContact.normal.dot(hullContact.normal) >= 1 - normalTolerance);
+    });
+    if (!match) {
+      EXCEPT("Prism misses a hull ground contact (" + name + ")");
+    }
+  }
+  if (std::abs(hullDepth - prismDepth) > contactTolerance) {
+    EXCEPT("Prism ground penetration differs from hull (" + name + ")");
+  }
+}
+
+static void compareTrajectories(const TwistyEnv &hullEnvironment,
+                                const TwistyEnv &prismEnvironment, const String &name) {
+  for (int i = 0; i < hullEnvironment.bodies.size(); i++) {
+    const auto &hullTransform = hullEnvironment.bodies[i]->getWorldTransform();
+    const auto &prismTransform = prismEnvironment.bodies[i]->getWorldTransform();
+    const auto offset = hullTransform.getOrigin().distance(prismTransform.getOrigin());
+    const auto angle = hullTransform.getRotation().angleShortestPath(prismTransform.getRotation());
+    if ((offset > trajectoryTolerance) || (angle > trajectoryTolerance)) {
+      EXCEPT("Prism trajectory diverges from hull (" + name + ")");
+    }
+  }
+}
+
+// Plays the same actions with the former hull shapes and with the prism shapes and their
+// plane algorithm, comparing ground contacts and body transforms after every step.
+// The tilt rotates the base link before the first step, so that it lands on an edge.
+static void checkPrismCollision(int linkCount, float tilt, TwistyEnv &hullEnvironment,
+                                TwistyEnv &prismEnvironment, const HullShapes &hullShapes) {
+  const auto name = "links:" + std::to_string(linkCount);
+  for (auto *environment : {&hullEnvironment, &prismEnvironment}) {
+    environment->randomGenerator = std::make_shared<RandomGenerator>(0);
+    environment->restart();
+  }
+  setLinkShapes(hullEnvironment, hullShapes.linkShapes);
+  const std::vector<btCollisionShape*> prismLinkShapes(prismEnvironment.shape->linkShapes.begin(),
+                                                       prismEnvironment.shape->linkShapes.end());
+  setLinkShapes(prismEnvironment, prismLinkShapes);
+  for (auto *environment : {&hullEnvironment, &prismEnvironment}) {
+    auto *body = environment->bodies[environment->baseLinkIndex];
+    auto transform = body->getWorldTransform();
+    transform.setRotation(btQuaternion(btVector3(1, 0, 1).normalized(), tilt) *
+                          transform.getRotation());
+    body->setWorldTransform(transform);
+    body->setInterpolationWorldTransform(transform);
+  }
+
+  RandomGenerator randomGenerator(0);
+  std::uniform_real_distribution<float> distribution(-1, 1);
+  Action action(0.0, prismEnvironment.actionLength);
+  for (int i = 0; i < collisionStepCount; i++) {
+    for (auto &value : action) {
+      value = distribution(randomGenerator);
+    }
+    hullEnvironment.step(action);
+    prismEnvironment.step(action);
+    compareTrajectories(hullEnvironment, prismEnvironment, name);
+    compareContacts(groundContacts(hullEnvironment), groundContacts(prismEnvironment), name);
+  }
+}
+
+// Drops and rests a single prism, then runs a jointed chain, and times the collision
+// detection of a step for both shapes once the chain is in contact with the ground.
+static void benchPrismCollision(Benchmark &benchmark) {
+  for (const auto linkCount : {1, collisionLinkCount}) {
+    const auto shape = TwistyShape::acquire(chainShapeData(linkCount));
+    const HullShapes hullShapes(*shape);
+    TwistyEnv hullEnvironment(shape);
+    TwistyEnv prismEnvironment(shape);
+    checkPrismCollision(linkCount, (linkCount == 1 ? dropTilt : 0), hullEnvironment,
+                        prismEnvironment, hullShapes);
+    if (linkCount == 1) {
+      continue;
+    }
+
+    const auto suffix = "/links:" + std::to_string(linkCount);
+    benchmark.run("btConvexHullShape::collision" + suffix, [&]() {
+      hullEnvironment.dynamicsWorld->performDiscreteCollisionDetection();
+    });
+    benchmark.run("PrismShape::collision" + suffix, [&]() {
+      prismEnvironment.dynamicsWorld->performDiscreteCollisionDetection();
+    });
+  }
+}
+
+static void benchBase64(Benchmark &benchmark) {
+  TwistyEnv environment(chainShapeData(replayLinkCount));
+  Config config;
+  config.hiddenLayerSizes = hiddenLayerSizes.back();
+  Network network(config, environment.observation.size(), environment.actionLength);
+  std::ostringstream stream;
+  network.save(stream);
+  const auto data = stream.str();
+  const auto encoded = macaron::Base64::Encode(data);
+  const auto size = "/bytes:" + std::to_string(data.size());
+
+  benchmark.run("Base64::Encode" + size, [&]() {
+    sink = macaron::Base64::Encode(data).size();
+  });
+  String decoded;
+  benchmark.run("Base64::Decode" + size, [&]() {
+    macaron::Base64::Decode(encoded, decoded);
+    sink = decoded.size();
+  });
+}
+
+static rapidjson::Document resultsDocument(const Array<Benchmark::Result> &results) {
+  rapidjson::Document document(rapidjson::kObjectType);
+  auto &allocator = document.GetAllocator();
+  rapidjson::Value values(rapidjson::kArrayType);
+  for (const auto &result : results) {
+    rapidjson::Value value(rapidjson::kObjectType);
+    value.AddMember("name", rapidjson::Value(result.name, allocator), allocator);
+    value.AddMember("iterations", static_cast<int64_t>(result.iterations), allocator);
+    value.AddMember("medianTime", result.medianTime, allocator);
+    value.AddMember("minimumTime", result.minimumTime, allocator);
+    values.PushBack(value, allocator);
+  }
+  document.AddMember("results", values, allocator);
+  return document;
+}
+
+static int compareBaseline(const Array<Benchmark::Result> &results,
+                           const String &filePath, double tolerance) {
+  std::ifstream file(filePath);
+  rapidjson::IStreamWrapper stream(file);
+  rapidjson::Document baseline;
+  if (baseline.ParseStream(stream).HasParseError() || !baseline.HasMember("results")) {
+    std::cerr << "Invalid baseline: " << filePath << std::endl;
+    return -1;
+  }
+
+  std::map<String, double> baselineTimes;
+  for (const auto &value : baseline["results"].GetArray()) {
+    baselineTimes[value["name"].GetString()] = value["medianTime"].GetDouble();
+  }
+
+  int regressionCount = 0;
+  std::cout << std::endl;
+  for (const auto &result : results) {
+    const auto it = baselineTimes.find(result.name);
+    if (it == baselineTimes.end()) {
+      std::cout << result.name << ": no baseline" << std::endl;
+      continue;
+    }
+    const auto ratio = result.medianTime / it->second;
+    const auto regressed = (ratio > 1 + tolerance);
+    std::cout << result.name << ": " << ratio << "x" << (regressed ? " REGRESSION" : "") << std::endl;
+    if (regressed) {
+      regressionCount++;
+    }
+  }
+  return regressionCount;
+}
+
+int main(int argc, char* argv[]) {
+  String outputFilePath;
+  String baselineFilePath;
+  String filter;
+  double tolerance = 0.1;
+  double sampleTime = 0.1;
+  int sampleCount = 5;
+  for (int i = 1; i < argc; i++) {
+    const String argument = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << argument << std::endl;
+      return 1;
+    }
+    const String value = argv[++i];
+    if (argument == "--output") {
+      outputFilePath = value;
+    } else if (argument == "--baseline") {
+      baselineFilePath = value;
+    } else if (argument == "--filter") {
+      filter = value;
+    } else if (argument == "--tolerance") {
+      tolerance = std::stod(value);
+    } else if (argument == "--sample-time") {
+      sampleTime = std::stod(value);
+    } else if (argument == "--samples") {
+      sampleCount = std::stoi(value);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--output FILEPATH] [--baseline FILEPATH]"
+                << " [--filter NAME] [--tolerance RATIO] [--sample-time SECONDS]"
+                << " [--samples COUNT]" << std::endl;
+      return 1;
+    }
+  }
+
+  torch::set_num_threads(1);
+
+  Benchmark benchmark(filter, sampleTime, sampleCount);
+  benchEnvironment(benchmark);
+  benchPhysicsThreads(benchmark);
+  benchPrismShape(benchmark);
+  benchPrismCollision(benchmark);
+  benchNetwork(benchmark);
+  benchActorKernel(benchmark);
+  benchReplayBuffer(benchmark, false);
+  benchReplayBuffer(benchmark, true);
+  benchReplayBuffer(benchmark, false, ObservationFormat::Float16, ActionFormat::Int16, "/float16");
+  benchReplayBuffer(benchmark, false, ObservationFormat::BFloat16, ActionFormat::Int8, "/bfloat16");
+  benchReplayCodec(benchmark);
+  benchBase64(benchmark);
+
+  if (!outputFilePath.empty()) {
+    const auto document = resultsDocument(benchmark.results);
+    std::ofstream file(outputFilePath);
+    rapidjson::OStreamWrapper stream(file);
+    rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+    document.Accept(writer);
+  }
+
+  if (!baselineFilePath.empty()) {
+    const auto regressionCount = compareBaseline(benchmark.results, baselineFilePath, tolerance);
+    if (regressionCount != 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
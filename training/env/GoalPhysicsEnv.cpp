@@ -3,8 +3,10 @@
 
 static const float defaultTargetDistance = 30;
 
-GoalPhysicsEnv::GoalPhysicsEnv()
-    : baseBody(nullptr)
+GoalPhysicsEnv::GoalPhysicsEnv(const PhysicsConfig &physicsConfig)
+    : PhysicsEnv(physicsConfig)
+    , baseBody(nullptr)
+    , baseMultiBody(nullptr)
     , target(0, 0, 0)
     , aliveDistance(0)
     , targetStartDistance(0)
@@ -23,6 +25,7 @@ void GoalPhysicsEnv::reset() {
   PhysicsEnv::reset();
 
   baseBody = nullptr;
+  baseMultiBody = nullptr;
 
   resetTarget();
 }
@@ -30,8 +33,8 @@ void GoalPhysicsEnv::reset() {
 void GoalPhysicsEnv::resetTarget() {
   std::uniform_real_distribution<float> angleDistribution(0, SIMD_2_PI);
   const auto angle = angleDistribution(getRandomGenerator());
-  const btVector3 &startPosition = (baseBody != nullptr
-                                    ? baseBody->getWorldTransform().getOrigin()
+  const btVector3 &startPosition = (hasBase()
+                                    ? baseTransform().getOrigin()
                                     : btVector3(0, 0, 0));
   target.setX(startPosition.x() + targetStartDistance * std::cos(angle));
   target.setY(0);
@@ -40,8 +43,8 @@ void GoalPhysicsEnv::resetTarget() {
 }
 
 GoalPhysicsEnv::GoalInfo GoalPhysicsEnv::goalInfo() const {
-  const auto &position = baseBody->getWorldTransform().getOrigin();
-  const auto &basis = baseBody->getWorldTransform().getBasis();
+  const auto &position = baseTransform().getOrigin();
+  const auto &basis = baseTransform().getBasis();
   const auto &axisX = basis[0];
   const auto &axisY = basis[1];
   const auto &axisZ = basis[2];
@@ -53,13 +56,31 @@ GoalPhysicsEnv::GoalInfo GoalPhysicsEnv::goalInfo() const {
   const auto cosYaw = std::cos(yaw);
   const auto sinYaw = std::sin(yaw);
   const btMatrix3x3 invYawRotation(cosYaw, 0, sinYaw, 0, 1, 0, -sinYaw, 0, cosYaw);
-  const auto linearVelocity = invYawRotation * baseBody->getLinearVelocity();
-  const auto angularVelocity = invYawRotation * baseBody->getAngularVelocity();
+  const auto linearVelocity = invYawRotation * baseLinearVelocity();
+  const auto angularVelocity = invYawRotation * baseAngularVelocity();
   return {angleToGoal, pitch, roll, linearVelocity, angularVelocity};
 }
 
+bool GoalPhysicsEnv::hasBase() const {
+  return (baseBody != nullptr) || (baseMultiBody != nullptr);
+}
+
+const btTransform& GoalPhysicsEnv::baseTransform() const {
+  return (baseMultiBody != nullptr
+          ? baseMultiBody->getBaseCollider()->getWorldTransform()
+          : baseBody->getWorldTransform());
+}
+
+btVector3 GoalPhysicsEnv::baseLinearVelocity() const {
+  return (baseMultiBody != nullptr ? baseMultiBody->getBaseVel() : baseBody->getLinearVelocity());
+}
+
+btVector3 GoalPhysicsEnv::baseAngularVelocity() const {
+  return (baseMultiBody != nullptr ? baseMultiBody->getBaseOmega() : baseBody->getAngularVelocity());
+}
+
 float GoalPhysicsEnv::react(const Action &action, float timeStep) {
-  const auto distance = baseBody->getWorldTransform().getOrigin().distance(target);
+  const auto distance = baseTransform().getOrigin().distance(target);
   const auto reward = (prevDistance - distance) / timeStep;
   prevDistance = distance;
 
@@ -14,7 +14,7 @@ public:
     btVector3 angularVelocity;
   };
 
-  GoalPhysicsEnv();
+  GoalPhysicsEnv(const PhysicsConfig &physicsConfig = PhysicsConfig());
 
   void setTargetDistance(float distance);
 
@@ -24,9 +24,15 @@ public:
 
   GoalInfo goalInfo() const;
 
+  bool hasBase() const;
+  const btTransform& baseTransform() const;
+  btVector3 baseLinearVelocity() const;
+  btVector3 baseAngularVelocity() const;
+
   virtual float react(const Action &action, float timeStep) override;
 
   btRigidBody *baseBody;
+  btMultiBody *baseMultiBody;
   btVector3 target;
   float aliveDistance;
   float targetStartDistance;
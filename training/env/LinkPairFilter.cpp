@@ -0,0 +1,43 @@
+
+#include "LinkPairFilter.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/CollisionDispatch/btCollisionObject.h"
+#pragma clang diagnostic pop
+
+LinkPairFilter::LinkPairFilter(int linkCount)
+    : linkCount(linkCount)
+    , excludedPairCount(0)
+    , excludedPairs(linkCount * linkCount, false) {
+}
+
+bool LinkPairFilter::needBroadphaseCollision(btBroadphaseProxy *proxy0,
+                                             btBroadphaseProxy *proxy1) const {
+  if (((proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) == 0) ||
+      ((proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask) == 0)) {
+    return false;
+  }
+  const auto *object0 = static_cast<const btCollisionObject*>(proxy0->m_clientObject);
+  const auto *object1 = static_cast<const btCollisionObject*>(proxy1->m_clientObject);
+  const auto linkIndex0 = object0->getUserIndex2();
+  const auto linkIndex1 = object1->getUserIndex2();
+  if ((linkIndex0 < 0) || (linkIndex0 >= linkCount) ||
+      (linkIndex1 < 0) || (linkIndex1 >= linkCount)) {
+    return true;
+  }
+  return !excludedPairs[linkIndex0 * linkCount + linkIndex1];
+}
+
+void LinkPairFilter::exclude(int linkIndex0, int linkIndex1) {
+  if ((linkIndex0 == linkIndex1) || excluded(linkIndex0, linkIndex1)) {
+    return;
+  }
+  excludedPairs[linkIndex0 * linkCount + linkIndex1] = true;
+  excludedPairs[linkIndex1 * linkCount + linkIndex0] = true;
+  excludedPairCount++;
+}
+
+bool LinkPairFilter::excluded(int linkIndex0, int linkIndex1) const {
+  return excludedPairs[linkIndex0 * linkCount + linkIndex1];
+}
@@ -0,0 +1,31 @@
+
+#ifndef LINKPAIRFILTER_H
+#define LINKPAIRFILTER_H
+
+#include "Types.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#pragma clang diagnostic pop
+
+// Broadphase filter dropping pairs of links (collision objects tagged with the link index in
+// userIndex2) that can never come into contact, on top of the regular group and mask test.
+class LinkPairFilter : public btOverlapFilterCallback {
+public:
+  LinkPairFilter(int linkCount);
+
+  virtual bool needBroadphaseCollision(btBroadphaseProxy *proxy0,
+                                       btBroadphaseProxy *proxy1) const override;
+
+  void exclude(int linkIndex0, int linkIndex1);
+  bool excluded(int linkIndex0, int linkIndex1) const;
+
+  int excludedCount() const { return excludedPairCount; }
+
+  int linkCount;
+  int excludedPairCount;
+  Array<bool> excludedPairs;
+};
+
+#endif // LINKPAIRFILTER_H
@@ -0,0 +1,164 @@
+
+#include "PhysicsArena.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "LinearMath/btAlignedAllocator.h"
+#pragma clang diagnostic pop
+
+#include <algorithm>
+#include <cstdlib>
+
+static const size_t arenaBlockSize = 256 * 1024;
+static const size_t arenaLargeSize = arenaBlockSize / 4;
+
+static thread_local PhysicsArena *currentArena = nullptr;
+
+#ifdef TRAINING_PHYSICS_ARENA
+// Installed before main, ahead of any Bullet allocation, since frees read the routing header
+[[maybe_unused]] static const bool routedAllocatorInstalled =
+  (btAlignedAllocSetCustom(PhysicsArena::allocateRouted, PhysicsArena::deallocate), true);
+#endif
+
+static size_t alignSize(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+static std::mutex& registryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+static Array<const PhysicsArena*>& registry() {
+  static Array<const PhysicsArena*> arenas;
+  return arenas;
+}
+
+// Counts of destroyed arenas, kept in the totals
+static PhysicsArena::Statistics& retiredStatistics() {
+  static PhysicsArena::Statistics statistics;
+  return statistics;
+}
+
+PhysicsArena::Scope::Scope(PhysicsArena &arena)
+    : previous(currentArena) {
+  currentArena = &arena;
+}
+
+PhysicsArena::Scope::~Scope() {
+  currentArena = previous;
+}
+
+PhysicsArena::PhysicsArena()
+    : blockOffset(arenaBlockSize) {
+  std::lock_guard<std::mutex> lock(registryMutex());
+  registry().push_back(this);
+}
+
+PhysicsArena::~PhysicsArena() {
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto &arenas = registry();
+    arenas.erase(std::find(arenas.begin(), arenas.end(), this));
+    auto &retired = retiredStatistics();
+    retired.allocationCount += counters.allocationCount;
+    retired.deallocationCount += counters.deallocationCount;
+    retired.highWaterBytes = std::max(retired.highWaterBytes, counters.highWaterBytes);
+  }
+  for (auto *block : blocks) {
+    std::free(block);
+  }
+}
+
+void* PhysicsArena::allocate(size_t size) {
+  const auto totalSize = sizeof(Header) + alignSize(size, sizeof(Header));
+  Header *header = nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (totalSize > arenaLargeSize) {
+    header = static_cast<Header*>(std::aligned_alloc(alignof(Header), totalSize));
+    if (header == nullptr) {
+      throw std::bad_alloc();
+    }
+  } else {
+    auto &headers = freeHeaders[totalSize];
+    if (!headers.empty()) {
+      header = headers.back();
+      headers.pop_back();
+    } else {
+      if (blockOffset + totalSize > arenaBlockSize) {
+        auto *block = static_cast<char*>(std::aligned_alloc(alignof(Header), arenaBlockSize));
+        if (block == nullptr) {
+          throw std::bad_alloc();
+        }
+        blocks.push_back(block);
+        blockOffset = 0;
+        counters.reservedBytes += arenaBlockSize;
+      }
+      header = reinterpret_cast<Header*>(blocks.back() + blockOffset);
+      blockOffset += totalSize;
+    }
+  }
+  header->arena = this;
+  header->size = totalSize;
+  counters.allocationCount++;
+  counters.usedBytes += totalSize;
+  counters.highWaterBytes = std::max(counters.highWaterBytes, counters.usedBytes);
+  return header + 1;
+}
+
+void PhysicsArena::deallocate(void *pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+  auto *header = static_cast<Header*>(pointer) - 1;
+  if (header->arena != nullptr) {
+    header->arena->release(header);
+  } else {
+    std::free(header);
+  }
+}
+
+void PhysicsArena::release(Header *header) {
+  std::lock_guard<std::mutex> lock(mutex);
+  counters.deallocationCount++;
+  counters.usedBytes -= header->size;
+  if (header->size > arenaLargeSize) {
+    std::free(header);
+  } else {
+    freeHeaders[header->size].push_back(header);
+  }
+}
+
+PhysicsArena::Statistics PhysicsArena::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters;
+}
+
+// Counts cover every arena so far, sizes the live ones
+PhysicsArena::Statistics PhysicsArena::totalStatistics() {
+  std::lock_guard<std::mutex> lock(registryMutex());
+  auto total = retiredStatistics();
+  for (const auto *arena : registry()) {
+    const auto statistics = arena->statistics();
+    total.allocationCount += statistics.allocationCount;
+    total.deallocationCount += statistics.deallocationCount;
+    total.usedBytes += statistics.usedBytes;
+    total.highWaterBytes = std::max(total.highWaterBytes, statistics.highWaterBytes);
+    total.reservedBytes += statistics.reservedBytes;
+  }
+  return total;
+}
+
+void* PhysicsArena::allocateRouted(size_t size) {
+  if (currentArena != nullptr) {
+    return currentArena->allocate(size);
+  }
+  const auto totalSize = sizeof(Header) + alignSize(size, sizeof(Header));
+  auto *header = static_cast<Header*>(std::aligned_alloc(alignof(Header), totalSize));
+  if (header == nullptr) {
+    return nullptr;
+  }
+  header->arena = nullptr;
+  header->size = totalSize;
+  return header + 1;
+}
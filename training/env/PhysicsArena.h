@@ -0,0 +1,84 @@
+
+#ifndef PHYSICSARENA_H
+#define PHYSICSARENA_H
+
+#include "Types.h"
+
+#include <mutex>
+#include <unordered_map>
+
+// Memory arena owned by a physics world. Blocks are carved monotonically and released
+// allocations go to per-size free lists, so rebuilding a world reuses its own memory instead
+// of the global heap. With TRAINING_PHYSICS_ARENA, Bullet's aligned allocations made by a
+// thread inside a Scope are routed to the scope's arena as well.
+class PhysicsArena {
+public:
+  struct Statistics {
+    long long allocationCount = 0;
+    long long deallocationCount = 0;
+    long long usedBytes = 0;
+    long long highWaterBytes = 0; // largest used size of a single arena
+    long long reservedBytes = 0;
+  };
+
+  class Scope {
+  public:
+    explicit Scope(PhysicsArena &arena);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    PhysicsArena *previous;
+  };
+
+  PhysicsArena();
+  PhysicsArena(const PhysicsArena &arena) = delete;
+  ~PhysicsArena();
+
+  void* allocate(size_t size);
+  static void deallocate(void *pointer); // arena or routed heap allocation
+
+  // Objects must start at their allocation, which holds for single inheritance.
+  template<typename T, typename... Args>
+  T* create(Args&&... args);
+  template<typename T>
+  static void destroy(T *object);
+
+  Statistics statistics() const;
+  static Statistics totalStatistics();
+
+  // Bullet allocator hook, routing to the arena of the current scope or to the heap
+  static void* allocateRouted(size_t size);
+
+private:
+  struct alignas(16) Header {
+    PhysicsArena *arena;
+    size_t size;
+  };
+
+  void release(Header *header);
+
+  mutable std::mutex mutex;
+  Array<char*> blocks;
+  size_t blockOffset;
+  std::unordered_map<size_t, Array<Header*>> freeHeaders;
+  Statistics counters;
+};
+
+template<typename T, typename... Args>
+T* PhysicsArena::create(Args&&... args) {
+  static_assert(alignof(T) <= alignof(Header), "Arena allocations are 16 byte aligned");
+  return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+void PhysicsArena::destroy(T *object) {
+  if (object != nullptr) {
+    object->~T();
+    deallocate(object);
+  }
+}
+
+#endif // PHYSICSARENA_H
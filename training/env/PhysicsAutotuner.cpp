@@ -0,0 +1,97 @@
+
+#include "PhysicsAutotuner.h"
+#include "TwistyEnv.h"
+
+#include <cmath>
+
+static const int autotuneSeed = 0;
+static const float observationLimit = 1e3;
+static const int solverIterationCounts[] = {5, 10, 20};
+
+PhysicsAutotuner::PhysicsAutotuner(const String &shapeData, const PhysicsConfig &physicsConfig,
+                                   float tolerance, int stepCount)
+    : shapeData(shapeData)
+    , physicsConfig(physicsConfig)
+    , tolerance(tolerance)
+    , stepCount(stepCount) {
+}
+
+Array<PhysicsProfile> PhysicsAutotuner::candidates() const {
+  Array<PhysicsSolver> solvers = {PhysicsSolver::SequentialImpulse};
+  if (physicsConfig.threadCount <= 1) {
+    if (physicsConfig.backend == PhysicsBackend::RigidBody) {
+      solvers.push_back(PhysicsSolver::NNCG);
+    }
+    solvers.push_back(PhysicsSolver::Dantzig);
+    solvers.push_back(PhysicsSolver::Lemke);
+  }
+
+  Array<PhysicsProfile> profiles;
+  for (const auto broadphase : {PhysicsBroadphase::Dbvt, PhysicsBroadphase::AxisSweep,
+                                PhysicsBroadphase::BruteForce}) {
+    for (const auto solver : solvers) {
+      for (const auto solverIterations : solverIterationCounts) {
+        for (const auto splitImpulse : {true, false}) {
+          auto profile = physicsConfig.profile;
+          profile.broadphase = broadphase;
+          profile.solver = solver;
+          profile.solverIterations = solverIterations;
+          profile.splitImpulse = splitImpulse;
+          profiles.push_back(profile);
+        }
+      }
+    }
+  }
+  return profiles;
+}
+
+PhysicsAutotuner::Result PhysicsAutotuner::evaluate(const PhysicsProfile &profile) const {
+  auto config = physicsConfig;
+  config.profile = profile;
+  config.profileOverride = true;
+  TwistyEnv environment(shapeData, config);
+  environment.seed = autotuneSeed;
+  environment.restart();
+
+  typedef std::chrono::steady_clock Clock;
+  Result result = {profile, 0, 0, true};
+  double totalTime = 0;
+  int stepNumber = 0;
+  while (result.stable && (stepNumber < stepCount)) {
+    if (environment.done || environment.timeout()) {
+      environment.restart();
+    }
+    const auto action = environment.randomAction();
+    const auto startTime = Clock::now();
+    environment.step(action);
+    totalTime += std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+    stepNumber++;
+
+    result.jointError = std::max(result.jointError, static_cast<float>(environment.jointError()));
+    for (const auto value : environment.observation) {
+      if (!std::isfinite(value) || (std::abs(value) > observationLimit)) {
+        result.stable = false;
+      }
+    }
+  }
+  result.stepTime = totalTime / stepNumber;
+  result.stable = result.stable && (result.jointError <= tolerance);
+  return result;
+}
+
+void PhysicsAutotuner::run() {
+  results.clear();
+  for (const auto &profile : candidates()) {
+    results.push_back(evaluate(profile));
+  }
+}
+
+const PhysicsAutotuner::Result* PhysicsAutotuner::best() const {
+  const Result *bestResult = nullptr;
+  for (const auto &result : results) {
+    if (result.stable && ((bestResult == nullptr) || (result.stepTime < bestResult->stepTime))) {
+      bestResult = &result;
+    }
+  }
+  return bestResult;
+}
@@ -0,0 +1,34 @@
+
+#ifndef PHYSICSAUTOTUNER_H
+#define PHYSICSAUTOTUNER_H
+
+#include "Config.h"
+
+// Steps a shape under every supported physics profile and picks the fastest one whose
+// joints stay together within the tolerance and whose observations stay bounded.
+class PhysicsAutotuner {
+public:
+  struct Result {
+    PhysicsProfile profile;
+    double stepTime; // microseconds per environment step
+    float jointError;
+    bool stable;
+  };
+
+  PhysicsAutotuner(const String &shapeData, const PhysicsConfig &physicsConfig,
+                   float tolerance, int stepCount);
+
+  Array<PhysicsProfile> candidates() const;
+  Result evaluate(const PhysicsProfile &profile) const;
+
+  void run();
+  const Result* best() const;
+
+  String shapeData;
+  PhysicsConfig physicsConfig;
+  float tolerance;
+  int stepCount;
+  Array<Result> results;
+};
+
+#endif // PHYSICSAUTOTUNER_H
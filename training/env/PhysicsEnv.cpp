@@ -1,18 +1,121 @@
 
 #include "PhysicsEnv.h"
+#include "PhysicsScheduler.h"
+#include "Profiler.h"
 
-static const float defaultTimeStep = 0.01;
-static const int defaultFrameSteps = 4;
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/ConstraintSolver/btNNCGConstraintSolver.h"
+#include "BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h"
+#include "BulletDynamics/Featherstone/btMultiBodyMLCPConstraintSolver.h"
+#include "BulletDynamics/MLCPSolvers/btDantzigSolver.h"
+#include "BulletDynamics/MLCPSolvers/btLemkeSolver.h"
+#include "BulletDynamics/MLCPSolvers/btMLCPSolver.h"
+#pragma clang diagnostic pop
 
-PhysicsEnv::PhysicsEnv()
-    : timeStep(defaultTimeStep)
+static const int dispatcherGrainSize = 40;
+static const btScalar axisSweepExtent = 1000;
+
+static const char *broadphaseNames[] = {"dbvt", "axisSweep", "bruteForce"};
+static const char *solverNames[] = {"sequentialImpulse", "nncg", "dantzig", "lemke"};
+
+static void internalTick(btDynamicsWorld *world, btScalar timeStep) {
+  static_cast<PhysicsEnv*>(world->getWorldUserInfo())->tick(timeStep);
+}
+
+static btBroadphaseInterface* createBroadphase(PhysicsBroadphase broadphase) {
+  switch (broadphase) {
+  case PhysicsBroadphase::AxisSweep:
+    return new btAxisSweep3({-axisSweepExtent, -axisSweepExtent, -axisSweepExtent},
+                            {axisSweepExtent, axisSweepExtent, axisSweepExtent});
+  case PhysicsBroadphase::BruteForce:
+    return new btSimpleBroadphase();
+  default:
+    return new btDbvtBroadphase();
+  }
+}
+
+PhysicsEnv::PhysicsEnv(const PhysicsConfig &physicsConfig)
+    : solverMt(nullptr)
+    , mlcpSolver(nullptr)
+    , multiBodyWorld(nullptr)
+    , worldCaptured(false)
+    , timeStep(defaultTimeStep)
     , frameSteps(defaultFrameSteps) {
-  collisionConfiguration = new btDefaultCollisionConfiguration();
-  dispatcher = new btCollisionDispatcher(collisionConfiguration);
-  overlappingPairCache = new btDbvtBroadphase();
-  solver = new btSequentialImpulseConstraintSolver();
-  dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, overlappingPairCache,
-                                              solver, collisionConfiguration);
+  const PhysicsArena::Scope arenaScope(arena);
+  const auto &profile = physicsConfig.profile;
+  if (profile.solverIterations < 1) {
+    EXCEPT("Invalid solver iteration count: " + std::to_string(profile.solverIterations));
+  }
+  if ((physicsConfig.threadCount > 1) && (profile.solver != PhysicsSolver::SequentialImpulse)) {
+    EXCEPT("Multithreaded physics requires the sequential impulse solver");
+  }
+  if (profile.solver == PhysicsSolver::Dantzig) {
+    mlcpSolver = new btDantzigSolver();
+  } else if (profile.solver == PhysicsSolver::Lemke) {
+    mlcpSolver = new btLemkeSolver();
+  }
+
+  btDefaultCollisionConstructionInfo collisionInfo;
+  if (physicsConfig.collisionPoolSize > 0) {
+    collisionInfo.m_defaultMaxPersistentManifoldPoolSize = physicsConfig.collisionPoolSize;
+    collisionInfo.m_defaultMaxCollisionAlgorithmPoolSize = physicsConfig.collisionPoolSize;
+  }
+  collisionConfiguration = new btDefaultCollisionConfiguration(collisionInfo);
+  overlappingPairCache = createBroadphase(profile.broadphase);
+  if (physicsConfig.backend == PhysicsBackend::MultiBody) {
+    if (physicsConfig.threadCount > 1) {
+      EXCEPT("Multithreaded physics is not supported by the multibody backend");
+    }
+    if (profile.solver == PhysicsSolver::NNCG) {
+      EXCEPT("NNCG solver is not supported by the multibody backend");
+    }
+    dispatcher = new btCollisionDispatcher(collisionConfiguration);
+    auto *multiBodySolver = (mlcpSolver != nullptr)
+                            ? new btMultiBodyMLCPConstraintSolver(mlcpSolver)
+                            : new btMultiBodyConstraintSolver();
+    solver = multiBodySolver;
+    multiBodyWorld = new btMultiBodyDynamicsWorld(dispatcher, overlappingPairCache,
+                                                  multiBodySolver, collisionConfiguration);
+    dynamicsWorld = multiBodyWorld;
+  } else if (physicsConfig.threadCount > 1) {
+    PhysicsScheduler::install(physicsConfig.threadCount);
+    dispatcher = new btCollisionDispatcherMt(collisionConfiguration, dispatcherGrainSize);
+    auto *solverPool = new btConstraintSolverPoolMt(physicsConfig.threadCount);
+    solver = solverPool;
+    solverMt = new btSequentialImpulseConstraintSolverMt();
+    dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, overlappingPairCache, solverPool,
+                                                  solverMt, collisionConfiguration);
+  } else {
+    dispatcher = new btCollisionDispatcher(collisionConfiguration);
+    if (profile.solver == PhysicsSolver::NNCG) {
+      solver = new btNNCGConstraintSolver();
+    } else if (mlcpSolver != nullptr) {
+      solver = new btMLCPSolver(mlcpSolver);
+    } else {
+      solver = new btSequentialImpulseConstraintSolver();
+    }
+    dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, overlappingPairCache,
+                                                solver, collisionConfiguration);
+  }
+
+  auto &solverInfo = dynamicsWorld->getSolverInfo();
+  solverInfo.m_numIterations = profile.solverIterations;
+  solverInfo.m_splitImpulse = profile.splitImpulse;
+  solverInfo.m_warmstartingFactor = profile.warmstartingFactor;
+  if (mlcpSolver != nullptr) {
+    // Direct solvers work on a single system, without batching the islands
+    solverInfo.m_minimumSolverBatchSize = 1;
+  }
+
+  // Pairs and manifolds are processed in proxy order rather than in the order the
+  // broadphase found them, so a restored world steps like a freshly built one
+  dynamicsWorld->getDispatchInfo().m_deterministicOverlappingPairs = true;
+
+  dynamicsWorld->setInternalTickCallback(internalTick, this);
 }
 
 PhysicsEnv::~PhysicsEnv() {
@@ -23,7 +126,9 @@ PhysicsEnv::~PhysicsEnv() {
   }
 
   delete dynamicsWorld;
+  delete solverMt;
   delete solver;
+  delete mlcpSolver;
   delete overlappingPairCache;
   delete dispatcher;
   delete collisionConfiguration;
@@ -56,7 +161,7 @@ btCollisionObject* PhysicsEnv::createStatic(const String &shapeName, const btTra
   info.m_startWorldTransform = transform;
   info.m_friction = friction;
   info.m_restitution = restitution;
-  auto *body = new btRigidBody(info);
+  auto *body = arena.create<btRigidBody>(info);
   dynamicsWorld->addRigidBody(body, group, mask);
   return body;
 }
@@ -89,9 +194,10 @@ btRigidBody* PhysicsEnv::createBody(btCollisionShape *shape, const btTransform &
   info.m_startWorldTransform = transform;
   info.m_friction = friction;
   info.m_restitution = restitution;
-  auto *body = new btRigidBody(info);
+  auto *body = arena.create<btRigidBody>(info);
   body->setActivationState(DISABLE_DEACTIVATION);
   dynamicsWorld->addRigidBody(body, group, mask);
+  bodySnapshots.push_back({body});
   return body;
 }
 
@@ -100,9 +206,11 @@ PhysicsEnv::constrainBody(btRigidBody *body, const btTransform &frame,
                           const btVector3 &lowerLinearLimit, const btVector3 &upperLinearLimit,
                           const btVector3 &lowerAngularLimit, const btVector3 &upperAngularLimit,
                           bool disableCollisionsBetweenLinkedBodies, RotateOrder rotateOrder) {
-  auto *constraint = new btGeneric6DofSpring2Constraint(*body, frame, rotateOrder);
+  auto *constraint = arena.create<btGeneric6DofSpring2Constraint>(*body, frame, rotateOrder);
   limitConstraint(constraint, lowerLinearLimit, upperLinearLimit, lowerAngularLimit, upperAngularLimit);
   dynamicsWorld->addConstraint(constraint, disableCollisionsBetweenLinkedBodies);
+  constraintSnapshots.push_back({constraint, lowerLinearLimit, upperLinearLimit,
+                                 lowerAngularLimit, upperAngularLimit});
   return constraint;
 }
 
@@ -112,9 +220,12 @@ PhysicsEnv::constrainBodies(btRigidBody *body1, btRigidBody *body2,
                             const btVector3 &lowerLinearLimit, const btVector3 &upperLinearLimit,
                             const btVector3 &lowerAngularLimit, const btVector3 &upperAngularLimit,
                             bool disableCollisionsBetweenLinkedBodies, RotateOrder rotateOrder) {
-  auto *constraint = new btGeneric6DofSpring2Constraint(*body1, *body2, frame1, frame2, rotateOrder);
+  auto *constraint = arena.create<btGeneric6DofSpring2Constraint>(*body1, *body2, frame1, frame2,
+                                                                  rotateOrder);
   limitConstraint(constraint, lowerLinearLimit, upperLinearLimit, lowerAngularLimit, upperAngularLimit);
   dynamicsWorld->addConstraint(constraint, disableCollisionsBetweenLinkedBodies);
+  constraintSnapshots.push_back({constraint, lowerLinearLimit, upperLinearLimit,
+                                 lowerAngularLimit, upperAngularLimit});
   return constraint;
 }
 
@@ -127,21 +238,58 @@ void PhysicsEnv::limitConstraint(btGeneric6DofSpring2Constraint *constraint,
   constraint->setAngularUpperLimit(upperAngularLimit);
 }
 
+btMultiBodyLinkCollider* PhysicsEnv::createCollider(btMultiBody *multiBody, int linkIndex,
+                                                    const String &shapeName, const btTransform &transform,
+                                                    int group, int mask, float friction, float restitution) {
+  return createCollider(multiBody, linkIndex, getShape(shapeName), transform,
+                        group, mask, friction, restitution);
+}
+
+btMultiBodyLinkCollider* PhysicsEnv::createCollider(btMultiBody *multiBody, int linkIndex,
+                                                    btCollisionShape *shape, const btTransform &transform,
+                                                    int group, int mask, float friction, float restitution) {
+  auto *collider = arena.create<btMultiBodyLinkCollider>(multiBody, linkIndex);
+  collider->setCollisionShape(shape);
+  collider->setWorldTransform(transform);
+  collider->setFriction(friction);
+  collider->setRestitution(restitution);
+  collider->setActivationState(DISABLE_DEACTIVATION);
+  multiBodyWorld->addCollisionObject(collider, group, mask);
+  if (linkIndex == -1) {
+    multiBody->setBaseCollider(collider);
+  } else {
+    multiBody->getLink(linkIndex).m_collider = collider;
+  }
+  return collider;
+}
+
+// The callback is not owned and must outlive the objects in the world.
+void PhysicsEnv::setOverlapFilter(btOverlapFilterCallback *callback) {
+  dynamicsWorld->getPairCache()->setOverlapFilterCallback(callback);
+}
+
 void PhysicsEnv::removeObject(btCollisionObject *&object) {
   btRigidBody *body = btRigidBody::upcast(object);
   if ((body != nullptr) && (body->getMotionState() != nullptr)) {
     delete body->getMotionState();
   }
   dynamicsWorld->removeCollisionObject(object);
-  delete object;
+  PhysicsArena::destroy(object);
   object = nullptr;
 }
 
 void PhysicsEnv::resetWorld(bool keepStaticObjects) {
+  for (int i = (multiBodyWorld != nullptr ? multiBodyWorld->getNumMultiBodyConstraints() : 0) - 1;
+       i >= 0; i--) {
+    btMultiBodyConstraint *constraint = multiBodyWorld->getMultiBodyConstraint(i);
+    multiBodyWorld->removeMultiBodyConstraint(constraint);
+    PhysicsArena::destroy(constraint);
+  }
+
   for (int i = dynamicsWorld->getNumConstraints() - 1; i >= 0; i--) {
     btTypedConstraint *constraint = dynamicsWorld->getConstraint(i);
     dynamicsWorld->removeConstraint(constraint);
-    delete constraint;
+    PhysicsArena::destroy(constraint);
   }
 
   for (int i = dynamicsWorld->getNumCollisionObjects() - 1; i >= 0; i--) {
@@ -151,18 +299,154 @@ void PhysicsEnv::resetWorld(bool keepStaticObjects) {
     }
     removeObject(object);
   }
+
+  for (int i = (multiBodyWorld != nullptr ? multiBodyWorld->getNumMultiBodies() : 0) - 1; i >= 0; i--) {
+    btMultiBody *multiBody = multiBodyWorld->getMultiBody(i);
+    multiBodyWorld->removeMultiBody(multiBody);
+    PhysicsArena::destroy(multiBody);
+  }
+
+  bodySnapshots.clear();
+  constraintSnapshots.clear();
+  worldCaptured = false;
+}
+
+void PhysicsEnv::captureWorld() {
+  for (auto &snapshot : bodySnapshots) {
+    const auto *body = snapshot.body;
+    snapshot.transform = body->getWorldTransform();
+    snapshot.linearVelocity = body->getLinearVelocity();
+    snapshot.angularVelocity = body->getAngularVelocity();
+    snapshot.activationState = body->getActivationState();
+  }
+  worldCaptured = true;
+}
+
+// Bodies and constraints stay in the world. Their mutable state is written back
+// in place and every contact they own is dropped, so the next step starts from
+// the same bodies, proxies and overlapping pairs as right after capture.
+void PhysicsEnv::restoreWorld() {
+  auto *broadphase = dynamicsWorld->getBroadphase();
+  auto *dbvtBroadphase = dynamic_cast<btDbvtBroadphase*>(broadphase);
+  auto *pairCache = broadphase->getOverlappingPairCache();
+  for (const auto &snapshot : bodySnapshots) {
+    auto *body = snapshot.body;
+    body->setWorldTransform(snapshot.transform);
+    body->setInterpolationWorldTransform(snapshot.transform);
+    body->setLinearVelocity(snapshot.linearVelocity);
+    body->setAngularVelocity(snapshot.angularVelocity);
+    body->setInterpolationLinearVelocity(snapshot.linearVelocity);
+    body->setInterpolationAngularVelocity(snapshot.angularVelocity);
+    body->clearForces();
+    body->updateInertiaTensor();
+    body->forceActivationState(snapshot.activationState);
+    body->setDeactivationTime(0);
+    body->setHitFraction(1);
+
+    auto *proxy = body->getBroadphaseHandle();
+    pairCache->cleanProxyFromPairs(proxy, dispatcher);
+    btVector3 aabbMin, aabbMax;
+    body->getCollisionShape()->getAabb(snapshot.transform, aabbMin, aabbMax);
+    if (dbvtBroadphase != nullptr) {
+      // Tight leaves, as after insertion, instead of the enlarged ones left by motion
+      dbvtBroadphase->setAabbForceUpdate(proxy, aabbMin, aabbMax, dispatcher);
+    } else {
+      broadphase->setAabb(proxy, aabbMin, aabbMax, dispatcher);
+    }
+  }
+
+  // Pairs found against bounds the bodies had before the restore
+  auto &pairs = pairCache->getOverlappingPairArray();
+  for (int i = pairs.size() - 1; i >= 0; i--) {
+    auto *proxy0 = pairs[i].m_pProxy0;
+    auto *proxy1 = pairs[i].m_pProxy1;
+    if (!TestAabbAgainstAabb2(proxy0->m_aabbMin, proxy0->m_aabbMax,
+                              proxy1->m_aabbMin, proxy1->m_aabbMax)) {
+      pairCache->removeOverlappingPair(proxy0, proxy1, dispatcher);
+    }
+  }
+  broadphase->resetPool(dispatcher);
+
+  for (const auto &snapshot : constraintSnapshots) {
+    limitConstraint(snapshot.constraint, snapshot.lowerLinearLimit, snapshot.upperLinearLimit,
+                    snapshot.lowerAngularLimit, snapshot.upperAngularLimit);
+  }
+  solver->reset();
 }
 
 void PhysicsEnv::reset() {
   Environment::reset();
 
-  resetWorld(true);
+  if (worldCaptured) {
+    restoreWorld();
+  } else {
+    resetWorld(true);
+  }
 }
 
 float PhysicsEnv::act(const Action &action) {
+  const PhysicsArena::Scope arenaScope(arena);
   for (int i = 0; i < frameSteps; i++) {
-    applyForces(action);
+    {
+      PROFILE_SCOPE("PhysicsEnv::applyForces");
+      applyForces(action);
+    }
+    PROFILE_SCOPE("PhysicsEnv::stepSimulation");
     dynamicsWorld->stepSimulation(timeStep, 0);
   }
+  PROFILE_SCOPE("PhysicsEnv::react");
   return react(action, frameSteps * timeStep);
 }
+
+PhysicsBackend PhysicsEnv::parseBackend(const String &name) {
+  if (name == "rigidBody") {
+    return PhysicsBackend::RigidBody;
+  } else if (name == "multiBody") {
+    return PhysicsBackend::MultiBody;
+  }
+  EXCEPT("Invalid physics backend: " + name);
+}
+
+PhysicsBroadphase PhysicsEnv::parseBroadphase(const String &name) {
+  for (int i = 0; i < std::size(broadphaseNames); i++) {
+    if (name == broadphaseNames[i]) {
+      return static_cast<PhysicsBroadphase>(i);
+    }
+  }
+  EXCEPT("Invalid physics broadphase: " + name);
+}
+
+PhysicsSolver PhysicsEnv::parseSolver(const String &name) {
+  for (int i = 0; i < std::size(solverNames); i++) {
+    if (name == solverNames[i]) {
+      return static_cast<PhysicsSolver>(i);
+    }
+  }
+  EXCEPT("Invalid physics solver: " + name);
+}
+
+// Profile in the shape data format:
+// broadphase solver solverIterations splitImpulse warmstartingFactor
+PhysicsProfile PhysicsEnv::parseProfile(std::istream &stream) {
+  String broadphaseName;
+  String solverName;
+  PhysicsProfile profile;
+  stream >> broadphaseName >> solverName >> profile.solverIterations
+         >> profile.splitImpulse >> profile.warmstartingFactor;
+  if (!stream) {
+    EXCEPT("Invalid physics profile");
+  }
+  profile.broadphase = parseBroadphase(broadphaseName);
+  profile.solver = parseSolver(solverName);
+  return profile;
+}
+
+String PhysicsEnv::formatProfile(const PhysicsProfile &profile) {
+  std::ostringstream stream;
+  stream << broadphaseNames[static_cast<int>(profile.broadphase)] << " "
+         << solverNames[static_cast<int>(profile.solver)] << " "
+         << profile.solverIterations << " "
+         << profile.splitImpulse << " "
+         << profile.warmstartingFactor;
+  return stream.str();
+}
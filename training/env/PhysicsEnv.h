@@ -3,15 +3,36 @@
 #define PHYSICSENV_H
 
 #include "Environment.h"
+#include "Config.h"
+#include "PhysicsArena.h"
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Weverything"
 #include "btBulletDynamicsCommon.h"
+#include "BulletDynamics/Featherstone/btMultiBody.h"
+#include "BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h"
+#include "BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
+#include "BulletDynamics/MLCPSolvers/btMLCPSolverInterface.h"
 #pragma clang diagnostic pop
 
 class PhysicsEnv : public Environment {
 public:
-  PhysicsEnv();
+  struct BodySnapshot {
+    btRigidBody *body;
+    btTransform transform;
+    btVector3 linearVelocity;
+    btVector3 angularVelocity;
+    int activationState;
+  };
+  struct ConstraintSnapshot {
+    btGeneric6DofSpring2Constraint *constraint;
+    btVector3 lowerLinearLimit;
+    btVector3 upperLinearLimit;
+    btVector3 lowerAngularLimit;
+    btVector3 upperAngularLimit;
+  };
+
+  PhysicsEnv(const PhysicsConfig &physicsConfig = PhysicsConfig());
   PhysicsEnv(const PhysicsEnv &env) = delete;
   virtual ~PhysicsEnv();
 
@@ -49,29 +70,60 @@ public:
                        const btVector3 &lowerLinearLimit, const btVector3 &upperLinearLimit,
                        const btVector3 &lowerAngularLimit, const btVector3 &upperAngularLimit);
 
+  btMultiBodyLinkCollider* createCollider(btMultiBody *multiBody, int linkIndex,
+                                          const String &shapeName, const btTransform &transform,
+                                          int group, int mask, float friction, float restitution);
+  btMultiBodyLinkCollider* createCollider(btMultiBody *multiBody, int linkIndex,
+                                          btCollisionShape *shape, const btTransform &transform,
+                                          int group, int mask, float friction, float restitution);
+
+  void setOverlapFilter(btOverlapFilterCallback *callback);
+
   void removeObject(btCollisionObject *&object);
 
   void resetWorld(bool keepStaticObjects);
 
+  void captureWorld();
+  void restoreWorld();
+
   virtual void reset() override;
 
   virtual float act(const Action &action) override;
   virtual void applyForces(const Action &action) = 0;
   virtual float react(const Action &action, float timeStep) = 0;
+  virtual void tick(btScalar timeStep) {} // after every internal simulation step
+
+  static PhysicsBackend parseBackend(const String &name);
+  static PhysicsBroadphase parseBroadphase(const String &name);
+  static PhysicsSolver parseSolver(const String &name);
+  static PhysicsProfile parseProfile(std::istream &stream);
+  static String formatProfile(const PhysicsProfile &profile);
+
+  static constexpr float defaultTimeStep = 0.01;
+  static const int defaultFrameSteps = 4;
 
   static const int staticGroup = 1;
   static const int dynamicGroup = 2;
   static const int staticMask = -1 ^ staticGroup;
   static const int dynamicMask = -1;
 
+  PhysicsArena arena; // outlives every world object
+
   btDefaultCollisionConfiguration *collisionConfiguration;
   btCollisionDispatcher *dispatcher;
   btBroadphaseInterface *overlappingPairCache;
-  btSequentialImpulseConstraintSolver *solver;
+  btConstraintSolver *solver;
+  btConstraintSolver *solverMt;
+  btMLCPSolverInterface *mlcpSolver;
   btDiscreteDynamicsWorld *dynamicsWorld;
+  btMultiBodyDynamicsWorld *multiBodyWorld;
 
   Map<String, btCollisionShape*> shapes;
 
+  Array<BodySnapshot> bodySnapshots;
+  Array<ConstraintSnapshot> constraintSnapshots;
+  bool worldCaptured;
+
   float timeStep;
   int frameSteps;
 };
@@ -0,0 +1,53 @@
+
+#include "PhysicsScheduler.h"
+#include "TaskPool.h"
+
+#include <mutex>
+
+void PhysicsScheduler::install(int threadCount) {
+#if BT_THREADSAFE
+  TaskPool::instance().reserve(threadCount);
+  static PhysicsScheduler scheduler;
+  static std::once_flag installFlag;
+  std::call_once(installFlag, []() { btSetTaskScheduler(&scheduler); });
+#else
+  EXCEPT("Multithreaded physics requires Bullet built with BT_THREADSAFE");
+#endif
+}
+
+PhysicsScheduler::PhysicsScheduler()
+    : btITaskScheduler("TaskPool") {
+}
+
+int PhysicsScheduler::getMaxNumThreads() const {
+  return BT_MAX_THREAD_COUNT;
+}
+
+// Bullet sizes per-thread buffers by this count and indexes them with btGetCurrentThreadIndex(),
+// which is handed out to any thread that steps a world, not only to pool threads.
+int PhysicsScheduler::getNumThreads() const {
+  return BT_MAX_THREAD_COUNT;
+}
+
+void PhysicsScheduler::setNumThreads(int numThreads) {
+  TaskPool::instance().reserve(numThreads);
+}
+
+void PhysicsScheduler::parallelFor(int iBegin, int iEnd, int grainSize,
+                                   const btIParallelForBody &body) {
+  TaskPool::instance().parallelFor(iBegin, iEnd, grainSize, [&body](int begin, int end) {
+    body.forLoop(begin, end);
+  });
+}
+
+btScalar PhysicsScheduler::parallelSum(int iBegin, int iEnd, int grainSize,
+                                       const btIParallelSumBody &body) {
+  std::mutex sumMutex;
+  btScalar sum = 0;
+  TaskPool::instance().parallelFor(iBegin, iEnd, grainSize, [&](int begin, int end) {
+    const auto partialSum = body.sumLoop(begin, end);
+    std::lock_guard<std::mutex> lock(sumMutex);
+    sum += partialSum;
+  });
+  return sum;
+}
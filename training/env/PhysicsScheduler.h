@@ -0,0 +1,29 @@
+
+#ifndef PHYSICSSCHEDULER_H
+#define PHYSICSSCHEDULER_H
+
+#include "Types.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "LinearMath/btThreads.h"
+#pragma clang diagnostic pop
+
+// Bullet task scheduler running parallel loops on the shared TaskPool.
+class PhysicsScheduler : public btITaskScheduler {
+public:
+  static void install(int threadCount);
+
+  PhysicsScheduler();
+
+  virtual int getMaxNumThreads() const override;
+  virtual int getNumThreads() const override;
+  virtual void setNumThreads(int numThreads) override;
+
+  virtual void parallelFor(int iBegin, int iEnd, int grainSize,
+                           const btIParallelForBody &body) override;
+  virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize,
+                               const btIParallelSumBody &body) override;
+};
+
+#endif // PHYSICSSCHEDULER_H
@@ -0,0 +1,100 @@
+
+#include "PrismPlaneCollisionAlgorithm.h"
+#include "PrismShape.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletCollision/CollisionDispatch/btManifoldResult.h"
+#include "BulletCollision/CollisionShapes/btStaticPlaneShape.h"
+#pragma clang diagnostic pop
+
+btCollisionAlgorithm*
+PrismPlaneCollisionAlgorithm::CreateFunc::CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo &info,
+                                                                   const btCollisionObjectWrapper *body0Wrap,
+                                                                   const btCollisionObjectWrapper *body1Wrap) {
+  auto *memory = info.m_dispatcher1->allocateCollisionAlgorithm(sizeof(PrismPlaneCollisionAlgorithm));
+  return new (memory) PrismPlaneCollisionAlgorithm(info.m_manifold, info, body0Wrap, body1Wrap, m_swapped);
+}
+
+PrismPlaneCollisionAlgorithm::PrismPlaneCollisionAlgorithm(btPersistentManifold *manifold,
+                                                           const btCollisionAlgorithmConstructionInfo &info,
+                                                           const btCollisionObjectWrapper *body0Wrap,
+                                                           const btCollisionObjectWrapper *body1Wrap,
+                                                           bool swapped)
+    : btCollisionAlgorithm(info)
+    , manifold(manifold)
+    , ownManifold(false)
+    , swapped(swapped) {
+  const auto *prismWrap = (swapped ? body1Wrap : body0Wrap);
+  const auto *planeWrap = (swapped ? body0Wrap : body1Wrap);
+  if ((this->manifold == nullptr) &&
+      m_dispatcher->needsCollision(prismWrap->getCollisionObject(), planeWrap->getCollisionObject())) {
+    this->manifold = m_dispatcher->getNewManifold(prismWrap->getCollisionObject(),
+                                                  planeWrap->getCollisionObject());
+    ownManifold = true;
+  }
+}
+
+PrismPlaneCollisionAlgorithm::~PrismPlaneCollisionAlgorithm() {
+  if (ownManifold && (manifold != nullptr)) {
+    m_dispatcher->releaseManifold(manifold);
+  }
+}
+
+void PrismPlaneCollisionAlgorithm::processCollision(const btCollisionObjectWrapper *body0Wrap,
+                                                    const btCollisionObjectWrapper *body1Wrap,
+                                                    const btDispatcherInfo &dispatchInfo,
+                                                    btManifoldResult *resultOut) {
+  if (manifold == nullptr) {
+    return;
+  }
+
+  const auto *prismWrap = (swapped ? body1Wrap : body0Wrap);
+  const auto *planeWrap = (swapped ? body0Wrap : body1Wrap);
+  const auto *prismShape = static_cast<const PrismShape*>(prismWrap->getCollisionShape());
+  const auto *planeShape = static_cast<const btStaticPlaneShape*>(planeWrap->getCollisionShape());
+  const auto &planeNormal = planeShape->getPlaneNormal();
+  const auto planeConstant = planeShape->getPlaneConstant() + prismShape->getMargin();
+  const auto &planeTransform = planeWrap->getWorldTransform();
+  const auto prismInPlane = planeTransform.inverseTimes(prismWrap->getWorldTransform());
+  const auto normalOnPlane = planeTransform.getBasis() * planeNormal;
+  const auto threshold = manifold->getContactBreakingThreshold();
+
+  resultOut->setPersistentManifold(manifold);
+  for (const auto &vertex : prismShape->vertices) {
+    const auto vertexInPlane = prismInPlane(vertex);
+    const auto distance = planeNormal.dot(vertexInPlane) - planeConstant;
+    if (distance < threshold) {
+      const auto pointOnPlane = vertexInPlane - (distance + prismShape->getMargin()) * planeNormal;
+      resultOut->addContactPoint(normalOnPlane, planeTransform(pointOnPlane), distance);
+    }
+  }
+
+  if (ownManifold && (manifold->getNumContacts() != 0)) {
+    resultOut->refreshContactPoints();
+  }
+}
+
+btScalar PrismPlaneCollisionAlgorithm::calculateTimeOfImpact(btCollisionObject *body0,
+                                                             btCollisionObject *body1,
+                                                             const btDispatcherInfo &dispatchInfo,
+                                                             btManifoldResult *resultOut) {
+  return 1;
+}
+
+void PrismPlaneCollisionAlgorithm::getAllContactManifolds(btManifoldArray &manifoldArray) {
+  if (ownManifold && (manifold != nullptr)) {
+    manifoldArray.push_back(manifold);
+  }
+}
+
+void PrismPlaneCollisionAlgorithm::registerAlgorithms(btCollisionDispatcher *dispatcher) {
+  static CreateFunc createFunc;
+  static CreateFunc swappedCreateFunc;
+  swappedCreateFunc.m_swapped = true;
+  dispatcher->registerCollisionCreateFunc(CUSTOM_POLYHEDRAL_SHAPE_TYPE, STATIC_PLANE_PROXYTYPE,
+                                          &createFunc);
+  dispatcher->registerCollisionCreateFunc(STATIC_PLANE_PROXYTYPE, CUSTOM_POLYHEDRAL_SHAPE_TYPE,
+                                          &swappedCreateFunc);
+}
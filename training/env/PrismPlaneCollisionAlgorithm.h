@@ -0,0 +1,47 @@
+
+#ifndef PRISMPLANECOLLISIONALGORITHM_H
+#define PRISMPLANECOLLISIONALGORITHM_H
+
+#include "Types.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btCollisionCreateFunc.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#pragma clang diagnostic pop
+
+// Prism against static plane contacts taken directly from the prism vertices, replacing
+// the single support point and perturbation iterations of btConvexPlaneCollisionAlgorithm.
+class PrismPlaneCollisionAlgorithm : public btCollisionAlgorithm {
+public:
+  struct CreateFunc : public btCollisionAlgorithmCreateFunc {
+    virtual btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo &info,
+                                                           const btCollisionObjectWrapper *body0Wrap,
+                                                           const btCollisionObjectWrapper *body1Wrap) override;
+  };
+
+  PrismPlaneCollisionAlgorithm(btPersistentManifold *manifold,
+                               const btCollisionAlgorithmConstructionInfo &info,
+                               const btCollisionObjectWrapper *body0Wrap,
+                               const btCollisionObjectWrapper *body1Wrap,
+                               bool swapped);
+  virtual ~PrismPlaneCollisionAlgorithm();
+
+  virtual void processCollision(const btCollisionObjectWrapper *body0Wrap,
+                                const btCollisionObjectWrapper *body1Wrap,
+                                const btDispatcherInfo &dispatchInfo,
+                                btManifoldResult *resultOut) override;
+  virtual btScalar calculateTimeOfImpact(btCollisionObject *body0, btCollisionObject *body1,
+                                         const btDispatcherInfo &dispatchInfo,
+                                         btManifoldResult *resultOut) override;
+  virtual void getAllContactManifolds(btManifoldArray &manifoldArray) override;
+
+  static void registerAlgorithms(btCollisionDispatcher *dispatcher);
+
+  btPersistentManifold *manifold;
+  bool ownManifold;
+  bool swapped;
+};
+
+#endif // PRISMPLANECOLLISIONALGORITHM_H
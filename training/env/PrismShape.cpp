@@ -0,0 +1,91 @@
+
+#include "PrismShape.h"
+
+static const std::array<std::pair<int, int>, 9> prismEdges = {{
+  {0, 2}, {2, 4}, {4, 0},
+  {1, 3}, {3, 5}, {5, 1},
+  {0, 1}, {2, 3}, {4, 5}
+}};
+
+PrismShape::PrismShape(btScalar halfBase, btScalar bottom, btScalar top, btScalar halfDepth,
+                       btScalar margin)
+    : cornersX(-halfBase, 0, halfBase)
+    , cornersY(bottom, top, bottom)
+    , halfDepth(halfDepth) {
+  m_shapeType = CUSTOM_POLYHEDRAL_SHAPE_TYPE;
+
+  for (int i = 0; i < vertexCount; i++) {
+    vertices[i] = {cornersX[i / 2], cornersY[i / 2], (i % 2 == 0 ? -halfDepth : halfDepth)};
+  }
+
+  const auto height = top - bottom;
+  planeNormals[0] = {0, 0, -1};
+  planeNormals[1] = {0, 0, 1};
+  planeNormals[2] = {0, -1, 0};
+  planeNormals[3] = btVector3(-height, halfBase, 0).normalized();
+  planeNormals[4] = btVector3(height, halfBase, 0).normalized();
+  planeOffsets[0] = halfDepth;
+  planeOffsets[1] = halfDepth;
+  planeOffsets[2] = -bottom;
+  planeOffsets[3] = planeNormals[3].dot(vertices[2]);
+  planeOffsets[4] = planeNormals[4].dot(vertices[2]);
+
+  setMargin(margin);
+  recalcLocalAabb();
+  initializePolyhedralFeatures(1);
+}
+
+// The triangle corner is chosen from three lane-parallel dot products and the cap from
+// the sign of the z component, so no loop over hull points is needed.
+btVector3 PrismShape::localGetSupportingVertexWithoutMargin(const btVector3 &direction) const {
+  const auto dots = cornersX * direction.x() + cornersY * direction.y();
+  const auto corner = dots.maxAxis();
+  return {cornersX[corner], cornersY[corner], (direction.z() < 0 ? -halfDepth : halfDepth)};
+}
+
+void PrismShape::batchedUnitVectorGetSupportingVertexWithoutMargin(const btVector3 *directions,
+                                                                   btVector3 *supportVertices,
+                                                                   int count) const {
+  for (int i = 0; i < count; i++) {
+    supportVertices[i] = localGetSupportingVertexWithoutMargin(directions[i]);
+  }
+}
+
+int PrismShape::getNumVertices() const {
+  return vertexCount;
+}
+
+int PrismShape::getNumEdges() const {
+  return static_cast<int>(prismEdges.size());
+}
+
+void PrismShape::getEdge(int i, btVector3 &pa, btVector3 &pb) const {
+  pa = vertices[prismEdges[i].first];
+  pb = vertices[prismEdges[i].second];
+}
+
+void PrismShape::getVertex(int i, btVector3 &vertex) const {
+  vertex = vertices[i];
+}
+
+int PrismShape::getNumPlanes() const {
+  return planeCount;
+}
+
+void PrismShape::getPlane(btVector3 &planeNormal, btVector3 &planeSupport, int i) const {
+  planeNormal = planeNormals[i];
+  planeSupport = planeNormals[i] * planeOffsets[i];
+}
+
+bool PrismShape::isInside(const btVector3 &point, btScalar tolerance) const {
+  for (int i = 0; i < planeCount; i++) {
+    if (planeNormals[i].dot(point) - planeOffsets[i] > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char* PrismShape::getName() const {
+  return "Prism";
+}
@@ -0,0 +1,46 @@
+
+#ifndef PRISMSHAPE_H
+#define PRISMSHAPE_H
+
+#include "Types.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/CollisionShapes/btPolyhedralConvexShape.h"
+#pragma clang diagnostic pop
+
+// Isosceles triangular prism extruded along z, with the triangle (-halfBase, bottom),
+// (0, top), (halfBase, bottom). Vertices are ordered as the triangle corners, each
+// at -halfDepth and then +halfDepth. The margin is added around them as for hull shapes,
+// and the polyhedral features used for clipping are shifted out by it.
+class PrismShape : public btPolyhedralConvexAabbCachingShape {
+public:
+  PrismShape(btScalar halfBase, btScalar bottom, btScalar top, btScalar halfDepth, btScalar margin);
+
+  virtual btVector3 localGetSupportingVertexWithoutMargin(const btVector3 &direction) const override;
+  virtual void batchedUnitVectorGetSupportingVertexWithoutMargin(const btVector3 *directions,
+                                                                 btVector3 *supportVertices,
+                                                                 int count) const override;
+
+  virtual int getNumVertices() const override;
+  virtual int getNumEdges() const override;
+  virtual void getEdge(int i, btVector3 &pa, btVector3 &pb) const override;
+  virtual void getVertex(int i, btVector3 &vertex) const override;
+  virtual int getNumPlanes() const override;
+  virtual void getPlane(btVector3 &planeNormal, btVector3 &planeSupport, int i) const override;
+  virtual bool isInside(const btVector3 &point, btScalar tolerance) const override;
+
+  virtual const char* getName() const override;
+
+  static const int vertexCount = 6;
+  static const int planeCount = 5;
+
+  btVector3 cornersX;
+  btVector3 cornersY;
+  btScalar halfDepth;
+  std::array<btVector3, vertexCount> vertices;
+  std::array<btVector3, planeCount> planeNormals;
+  std::array<btScalar, planeCount> planeOffsets;
+};
+
+#endif // PRISMSHAPE_H
@@ -1,155 +1,135 @@
 
 #include "TwistyEnv.h"
+#include "PrismPlaneCollisionAlgorithm.h"
+#include "Profiler.h"
 
-#include <filesystem>
-
-static const float prismHeight = 1;
-static const float prismBase = 2 * prismHeight;
-static const float prismSide = std::sqrt(prismBase);
-static const float prismHalfHeight = prismHeight / 2;
-static const float prismHalfBase = prismBase / 2;
-static const float prismHalfSide = prismSide / 2;
-
-static const float prismMargin = 0.04;
-static const float prismMarginDiag = prismMargin * std::cos(SIMD_PI / 4);
-
-static const float prismCgH = prismHeight / 3;
-static const float prismCgDy = prismHalfHeight - prismCgH;
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletDynamics/Featherstone/btMultiBodyJointLimitConstraint.h"
+#pragma clang diagnostic pop
 
 static const float jointLimit = 0.99;
 
-static const int defaultEnvironmentSteps = 1000;
-static const float defaultGravity = -9.81;
-static const float defaultTargetDistance = 30;
-static const float defaultGroundFriction = 0.8;
-static const float defaultPrismFriction = 0.8;
-static const float defaultGroundRestitution = 0;
-static const float defaultPrismRestitution = 0;
-
-static const float defaultAdvanceReward = 1;
-static const float defaultAliveReward = 0;
-static const float defaultForwardReward = 0;
-static const float defaultJointAtLimitCost = -10;
-static const float defaultDriveCost = 0;
-static const float defaultStallTorqueCost = 0;
-
-static const std::array<btVector3, 6> prismCollisionVertices = {{
-  {
-    -prismHalfBase + 2 * prismMarginDiag + prismMargin,
-    -prismHalfHeight + prismCgDy + prismMargin,
-    -prismHalfSide + prismMargin
-  },
-  {
-    -prismHalfBase + 2 * prismMarginDiag + prismMargin,
-    -prismHalfHeight + prismCgDy + prismMargin,
-    prismHalfSide - prismMargin
-  },
-  {
-    0,
-    prismHalfHeight + prismCgDy - 2 * prismMarginDiag,
-    -prismHalfSide + prismMargin
-  },
-  {
-    0,
-    prismHalfHeight + prismCgDy - 2 * prismMarginDiag,
-    prismHalfSide - prismMargin
-  },
-  {
-    prismHalfBase - 2 * prismMarginDiag - prismMargin,
-    -prismHalfHeight + prismCgDy + prismMargin,
-    -prismHalfSide + prismMargin
-  },
-  {
-    prismHalfBase - 2 * prismMarginDiag - prismMargin,
-    -prismHalfHeight + prismCgDy + prismMargin,
-    prismHalfSide - prismMargin
+// Contact callbacks are global, so the ground object points back to its environment and
+// each world only updates its own counters.
+static void updateGroundContacts(const btPersistentManifold *manifold, int change) {
+  const auto *body0 = manifold->getBody0();
+  const auto *body1 = manifold->getBody1();
+  const auto *ground = (body0->getUserPointer() != nullptr) ? body0 : body1;
+  auto *environment = static_cast<TwistyEnv*>(ground->getUserPointer());
+  if ((environment == nullptr) || (environment->groundObject != ground)) {
+    return;
   }
-}};
-
-template<typename T>
-static T readValue(std::istringstream &stream) {
-  T value;
-  stream >> value;
-  return value;
+  const auto linkIndex = ((ground == body0) ? body1 : body0)->getUserIndex2();
+  if ((linkIndex < 0) || (linkIndex >= environment->groundContacts.size())) {
+    return;
+  }
+  environment->groundContacts[linkIndex].fetch_add(change, std::memory_order_relaxed);
 }
 
-static btVector3 readVector(std::istringstream &stream) {
-  return {readValue<btScalar>(stream), readValue<btScalar>(stream), readValue<btScalar>(stream)};
+static void groundContactStarted(btPersistentManifold *const &manifold) {
+  updateGroundContacts(manifold, 1);
 }
 
-static btQuaternion readQuaternion(std::istringstream &stream) {
-  return {readValue<btScalar>(stream), readValue<btScalar>(stream),
-          readValue<btScalar>(stream), readValue<btScalar>(stream)};
+static void groundContactEnded(btPersistentManifold *const &manifold) {
+  updateGroundContacts(manifold, -1);
 }
 
-static btTransform readTransform(std::istringstream &stream) {
-  const auto position = readVector(stream);
-  auto orientation = readQuaternion(stream);
-  orientation.normalize();
-  return btTransform(orientation, position);
+TwistyEnv::TwistyEnv(const String &data, const PhysicsConfig &physicsConfig)
+    : TwistyEnv(TwistyShape::acquire(data), physicsConfig) {
 }
 
-TwistyEnv::TwistyEnv(const String &data)
-    : environmentSteps(defaultEnvironmentSteps)
-    , gravity(defaultGravity)
-    , targetDistance(defaultTargetDistance)
-    , groundFriction(defaultGroundFriction)
-    , prismFriction(defaultPrismFriction)
-    , groundRestitution(defaultGroundRestitution)
-    , prismRestitution(defaultPrismRestitution)
-    , advanceReward(defaultAdvanceReward)
-    , aliveReward(defaultAliveReward)
-    , forwardReward(defaultForwardReward)
-    , jointAtLimitCost(defaultJointAtLimitCost)
-    , driveCost(defaultDriveCost)
-    , stallTorqueCost(defaultStallTorqueCost)
-    , activeJointCount(0)
-    , baseLinkIndex(-1)
-    , groundObject(nullptr) {
-  parseData(data);
-  validateData();
+TwistyEnv::TwistyEnv(const TwistyShapePtr &shape, const PhysicsConfig &physicsConfig)
+    : GoalPhysicsEnv(shape->physicsConfig(physicsConfig))
+    , shape(shape)
+    , name(shape->name)
+    , environmentSteps(shape->environmentSteps)
+    , gravity(shape->gravity)
+    , targetDistance(shape->targetDistance)
+    , groundFriction(shape->groundFriction)
+    , prismFriction(shape->prismFriction)
+    , groundRestitution(shape->groundRestitution)
+    , prismRestitution(shape->prismRestitution)
+    , advanceReward(shape->advanceReward)
+    , aliveReward(shape->aliveReward)
+    , forwardReward(shape->forwardReward)
+    , jointAtLimitCost(shape->jointAtLimitCost)
+    , driveCost(shape->driveCost)
+    , stallTorqueCost(shape->stallTorqueCost)
+    , links(shape->links)
+    , joints(shape->joints)
+    , activeJointCount(shape->activeJointCount)
+    , jointStatesStale(true)
+    , baseLinkIndex(shape->baseLinkIndex)
+    , groundObject(nullptr)
+    , multiBody(nullptr) {
+  timeStep = shape->timeStep;
+  frameSteps = shape->frameSteps;
+  if (multiBodyWorld != nullptr) {
+    planArticulation();
+  }
+
+  for (int i = 0; i < joints.size(); i++) {
+    const auto &joint = joints[i];
+    if (joint.power == 0) {
+      continue;
+    }
+    activeJoints.push_back(i);
+    const auto freeJoint = (joint.lowerAngle >= joint.upperAngle);
+    jointStates.lowerLimits.push_back(freeJoint ? -SIMD_INFINITY
+                                      : std::min<btScalar>(btRadians(joint.lowerAngle) * jointLimit, 0));
+    jointStates.upperLimits.push_back(freeJoint ? SIMD_INFINITY
+                                      : std::max<btScalar>(btRadians(joint.upperAngle) * jointLimit, 0));
+  }
+  jointStates.axesA.resize(activeJointCount);
+  jointStates.axesB.resize(activeJointCount);
+  jointStates.angles.resize(activeJointCount);
+  jointStates.speeds.resize(activeJointCount);
 
   setTargetDistance(targetDistance);
 
   dynamicsWorld->setGravity({0, gravity, 0});
 
   groundObject = createGround(groundFriction, groundRestitution);
+  groundObject->setUserPointer(this);
+  groundContacts = std::vector<std::atomic<int>>(links.size());
+  gContactStartedCallback = groundContactStarted;
+  gContactEndedCallback = groundContactEnded;
 
   const auto observationLength = 10 + 2 * activeJointCount + links.size();
   Environment::init(observationLength, activeJointCount, environmentSteps);
 
-  auto *prismShape = new btConvexHullShape();
-  prismShape->setMargin(prismMargin);
-  for (const auto &vertex : prismCollisionVertices) {
-    prismShape->addPoint(vertex, false);
-  }
-  prismShape->recalcLocalAabb();
-  putShape("prism", prismShape);
+  PrismPlaneCollisionAlgorithm::registerAlgorithms(dispatcher);
+  setOverlapFilter(shape->linkPairFilter);
+}
+
+TwistyEnv::~TwistyEnv() {
+  // Objects are removed while the shared shapes and the contact counters are still alive
+  resetWorld(false);
+  setOverlapFilter(nullptr);
 }
 
 void TwistyEnv::reset() {
+  const PhysicsArena::Scope arenaScope(arena);
   GoalPhysicsEnv::reset();
+  jointStatesStale = true;
+
+  if (worldCaptured) {
+    baseBody = bodies[baseLinkIndex];
+    return;
+  }
 
   bodies.clear();
   constraints.clear();
 
-  auto *prismShape = getShape("prism");
+  if (multiBodyWorld != nullptr) {
+    buildArticulation();
+    return;
+  }
 
   for (int i = 0; i < links.size(); i++) {
     const auto &link = links[i];
-
-    const auto shapeName = "link" + std::to_string(i);
-    auto *linkShape = getShape(shapeName, false);
-    if (linkShape == nullptr) {
-      auto *shape = new btCompoundShape();
-      for (const auto &prism : link.prisms) {
-        shape->addChildShape(prism.transform, prismShape);
-      }
-      putShape(shapeName, shape);
-      linkShape = shape;
-    }
-
-    auto *body = createBody(shapeName, link.transform, dynamicGroup, dynamicMask,
+    auto *body = createBody(shape->linkShapes[i], link.transform, dynamicGroup, dynamicMask,
                             link.mass, link.inertia, prismFriction, prismRestitution);
     body->setUserIndex2(i);
     if (i == baseLinkIndex) {
@@ -175,9 +155,12 @@ void TwistyEnv::reset() {
                                        true);
     constraints.push_back(constraint);
   }
+
+  captureWorld();
 }
 
 void TwistyEnv::update() {
+  PROFILE_SCOPE("TwistyEnv::update");
   int index = 0;
   const auto [angleToGoal, pitch, roll, linearVelocity, angularVelocity] = goalInfo();
   observation[index++] = std::cos(angleToGoal);
@@ -192,60 +175,37 @@ void TwistyEnv::update() {
   observation[index++] = angularVelocity.z();
 
   // Joint parameters
-  for (int i = 0; i < joints.size(); i++) {
-    const auto &joint = joints[i];
-    if (joint.power == 0) {
-      continue;
-    }
-    auto *constraint = constraints[i];
-    const auto &axis = constraint->getCalculatedTransformB().getBasis().getColumn(0);
-    const auto &angularVelocity = constraint->getRigidBodyB().getAngularVelocity();
-    observation[index++] = -constraint->getAngle(0);
-    observation[index++] = (axis * angularVelocity).x();
+  refreshJointStates();
+  for (int i = 0; i < activeJointCount; i++) {
+    observation[index++] = -jointStates.angles[i];
+    observation[index++] = jointStates.speeds[i];
   }
 
   // Ground contacts
   for (int i = 0; i < links.size(); i++) {
-    observation[index + i] = 0;
-  }
-  const auto numManifolds = dynamicsWorld->getDispatcher()->getNumManifolds();
-  for (int i = 0; i < numManifolds; i++) {
-    const auto *contactManifold = dynamicsWorld->getDispatcher()->getManifoldByIndexInternal(i);
-    if (contactManifold->getNumContacts() == 0) {
-      continue;
-    }
-    const auto *body0 = contactManifold->getBody0();
-    const auto *body1 = contactManifold->getBody1();
-    if ((body0 != groundObject) && (body1 != groundObject)) {
-      continue;
-    }
-    const auto *body = (body0 == groundObject ? body1 : body0);
-    const auto linkIndex = body->getUserIndex2();
-    if (linkIndex == -1) {
-      continue;
-    }
-    if ((linkIndex == baseLinkIndex) && (aliveReward != 0)) {
+    const auto groundContact = (groundContacts[i].load(std::memory_order_relaxed) > 0);
+    if (groundContact && (i == baseLinkIndex) && (aliveReward != 0)) {
       done = true;
     }
-    observation[index + linkIndex] = 1;
+    observation[index + i] = groundContact ? 1 : 0;
   }
 }
 
 void TwistyEnv::applyForces(const Action &action) {
-  int actionIndex = 0;
-  for (int i = 0; i < joints.size(); i++) {
-    const auto &joint = joints[i];
-    if (joint.power == 0) {
-      continue;
+  if (multiBody != nullptr) {
+    for (int i = 0; i < activeJointCount; i++) {
+      const auto torque = action[i] * joints[activeJoints[i]].power;
+      const auto &articulatedJoint = articulatedJoints[activeJoints[i]];
+      multiBody->addJointTorque(articulatedJoint.linkIndex, articulatedJoint.sign * torque);
     }
-    auto *constraint = constraints[i];
-    constraint->calculateTransforms();
-    const auto torque = action[actionIndex] * joint.power;
-    const auto &axisB = constraint->getCalculatedTransformB().getBasis().getColumn(0);
-    const auto &axisA = constraint->getCalculatedTransformA().getBasis().getColumn(0);
-    constraint->getRigidBodyB().applyTorque(torque * axisB);
-    constraint->getRigidBodyA().applyTorque(-torque * axisA);
-    actionIndex++;
+    return;
+  }
+  refreshJointStates();
+  for (int i = 0; i < activeJointCount; i++) {
+    const auto torque = action[i] * joints[activeJoints[i]].power;
+    auto *constraint = constraints[activeJoints[i]];
+    constraint->getRigidBodyB().applyTorque(torque * jointStates.axesB[i]);
+    constraint->getRigidBodyA().applyTorque(-torque * jointStates.axesA[i]);
   }
 }
 
@@ -261,28 +221,19 @@ float TwistyEnv::react(const Action &action, float timeStep) {
     }
   }
 
+  refreshJointStates();
+  const auto *angles = jointStates.angles.data();
+  const auto *speeds = jointStates.speeds.data();
+  const auto *lowerLimits = jointStates.lowerLimits.data();
+  const auto *upperLimits = jointStates.upperLimits.data();
+  int atLimitCount = 0;
   float electricityCost = 0;
-  int actionIndex = 0;
-  for (int i = 0; i < joints.size(); i++) {
-    const auto &joint = joints[i];
-    if (joint.power == 0) {
-      continue;
-    }
-    auto *constraint = constraints[i];
-    constraint->calculateTransforms();
-    const auto &axis = constraint->getCalculatedTransformB().getBasis().getColumn(0);
-    const auto &angularVelocity = constraint->getRigidBodyB().getAngularVelocity();
-    const auto angle = constraint->getAngle(0);
-    const auto speed = (axis * angularVelocity).x();
-    if ((joint.lowerAngle < joint.upperAngle) &&
-        (((angle < 0) && (angle < btRadians(joint.lowerAngle) * jointLimit)) ||
-         ((angle > 0) && (angle > btRadians(joint.upperAngle) * jointLimit)))) {
-      reward += jointAtLimitCost;
-    }
-    electricityCost += driveCost * std::abs(action[actionIndex] * speed) +
-                       stallTorqueCost * action[actionIndex] * action[actionIndex];
-    actionIndex++;
+  for (int i = 0; i < activeJointCount; i++) {
+    atLimitCount += ((angles[i] < lowerLimits[i]) || (angles[i] > upperLimits[i]));
+    electricityCost += driveCost * std::abs(action[i] * speeds[i]) +
+                       stallTorqueCost * action[i] * action[i];
   }
+  reward += atLimitCount * jointAtLimitCost;
   if (activeJointCount > 0) {
     electricityCost /= activeJointCount;
   }
@@ -291,110 +242,164 @@ float TwistyEnv::react(const Action &action, float timeStep) {
   return reward;
 }
 
-void TwistyEnv::parseData(const String &data) {
-  if (data.empty()) {
-    EXCEPT("Data must be specified");
+void TwistyEnv::tick(btScalar timeStep) {
+  jointStatesStale = true;
+}
+
+// Joint states are computed at most once per simulation step, on first use after it.
+void TwistyEnv::refreshJointStates() {
+  if (!jointStatesStale) {
+    return;
   }
+  jointStatesStale = false;
 
-  String line;
-  auto lines = std::istringstream(data);
-  while (std::getline(lines, line)) {
-    if (line.length() < 2) {
-      EXCEPT("Invalid line: '" + line + "'");
+  if (multiBody != nullptr) {
+    updateLinkVelocities();
+    for (int i = 0; i < activeJointCount; i++) {
+      articulatedJointState(activeJoints[i], jointStates.angles[i], jointStates.speeds[i]);
     }
-    const auto type = line[0];
-    std::istringstream stream(line.substr(2));
-    switch (type) {
-    case 'o':
-      stream >> name;
-      break;
-    case 's':
-      timeStep = readValue<float>(stream);
-      frameSteps = readValue<int>(stream);
-      environmentSteps = readValue<int>(stream);
-      gravity = readValue<float>(stream);
-      targetDistance = readValue<float>(stream);
-      groundFriction = readValue<float>(stream);
-      prismFriction = readValue<float>(stream);
-      groundRestitution = readValue<float>(stream);
-      prismRestitution = readValue<float>(stream);
-      break;
-    case 'c':
-      advanceReward = readValue<float>(stream);
-      aliveReward = readValue<float>(stream);
-      forwardReward = readValue<float>(stream);
-      jointAtLimitCost = readValue<float>(stream);
-      driveCost = readValue<float>(stream);
-      stallTorqueCost = readValue<float>(stream);
-      break;
-    case 'l':
-      links.push_back({
-        readValue<float>(stream), // mass
-        readVector(stream), // inertia
-        readTransform(stream), // transform
-        {} // prisms
-      });
-      break;
-    case 'p':
-      if (links.empty()) {
-        EXCEPT("No link");
+    return;
+  }
+  for (int i = 0; i < activeJointCount; i++) {
+    auto *constraint = constraints[activeJoints[i]];
+    constraint->calculateTransforms();
+    jointStates.axesA[i] = constraint->getCalculatedTransformA().getBasis().getColumn(0);
+    jointStates.axesB[i] = constraint->getCalculatedTransformB().getBasis().getColumn(0);
+    jointStates.angles[i] = constraint->getAngle(0);
+    const auto &angularVelocity = constraint->getRigidBodyB().getAngularVelocity();
+    jointStates.speeds[i] = (jointStates.axesB[i] * angularVelocity).x();
+  }
+}
+
+// Orders the links breadth-first from the base so that every joint becomes a revolute
+// multibody link whose parent precedes it.
+void TwistyEnv::planArticulation() {
+  multiBodyLinks.assign(links.size(), -2);
+  articulatedJoints.assign(joints.size(), {-1, 1, -1, {0, 0, 0}});
+  articulationLinks.clear();
+  articulationParents.clear();
+  articulationJoints.clear();
+
+  multiBodyLinks[baseLinkIndex] = -1;
+  std::vector<int> queue = {baseLinkIndex};
+  for (int i = 0; i < queue.size(); i++) {
+    const auto linkIndex = queue[i];
+    for (int j = 0; j < joints.size(); j++) {
+      const auto &joint = joints[j];
+      if ((articulatedJoints[j].linkIndex != -1) ||
+          ((joint.baseIndex != linkIndex) && (joint.targetIndex != linkIndex))) {
+        continue;
       }
-      links.back().prisms.push_back({
-        readTransform(stream) // transform
-      });
-      break;
-    case 'j':
-      joints.push_back({
-        readValue<int>(stream), // base index
-        readValue<int>(stream), // target index
-        readValue<float>(stream), // lower angle
-        readValue<float>(stream), // upper angle
-        readValue<float>(stream), // power
-        readTransform(stream) // transform
-      });
-      break;
-    case 'b':
-      if (baseLinkIndex != -1) {
-        EXCEPT("Multiple bases not supported");
+      const auto childIndex = (joint.baseIndex == linkIndex ? joint.targetIndex : joint.baseIndex);
+      if (multiBodyLinks[childIndex] != -2) {
+        EXCEPT("Multibody backend requires joints to form a tree (joint with index " +
+               std::to_string(j) + " closes a loop)");
       }
-      baseLinkIndex = readValue<int>(stream);
-      break;
-    default:
-      EXCEPT("Invalid type: '" + String(1, type) + "'");
+      multiBodyLinks[childIndex] = articulationLinks.size();
+      articulatedJoints[j].linkIndex = articulationLinks.size();
+      articulatedJoints[j].sign = (joint.baseIndex == linkIndex ? 1 : -1);
+      articulationLinks.push_back(childIndex);
+      articulationParents.push_back(multiBodyLinks[linkIndex]);
+      articulationJoints.push_back(j);
+      queue.push_back(childIndex);
     }
   }
-
-  for (const auto &joint : joints) {
-    if (joint.power != 0) {
-      activeJointCount++;
+  for (int i = 0; i < links.size(); i++) {
+    if (multiBodyLinks[i] == -2) {
+      EXCEPT("Multibody backend requires link with index " + std::to_string(i) +
+             " to be jointed to the base");
     }
   }
-}
 
-void TwistyEnv::validateData() const {
-  if (baseLinkIndex == -1) {
-    EXCEPT("No base found");
+  for (int j = 0; j < joints.size(); j++) {
+    const auto &joint = joints[j];
+    const auto &targetLink = links[joint.targetIndex];
+    articulatedJoints[j].targetLinkIndex = multiBodyLinks[joint.targetIndex];
+    articulatedJoints[j].targetAxis = targetLink.transform.getBasis().transpose() *
+                                      joint.transform.getBasis().getColumn(0);
   }
-  if ((baseLinkIndex < 0) || (baseLinkIndex >= links.size())) {
-    EXCEPT("Out of range base link index (" + std::to_string(baseLinkIndex) + ")");
+}
+
+void TwistyEnv::buildArticulation() {
+  const auto &baseLink = links[baseLinkIndex];
+  multiBody = arena.create<btMultiBody>(articulationLinks.size(), baseLink.mass, baseLink.inertia,
+                                        false, false);
+  multiBody->setBaseWorldTransform(baseLink.transform);
+  for (int i = 0; i < articulationLinks.size(); i++) {
+    const auto &link = links[articulationLinks[i]];
+    const auto &joint = joints[articulationJoints[i]];
+    const auto parentIndex = articulationParents[i];
+    const auto &parentLink = links[parentIndex == -1 ? baseLinkIndex : articulationLinks[parentIndex]];
+    const auto &pivot = joint.transform.getOrigin();
+    const auto &basis = link.transform.getBasis();
+    const auto &parentBasis = parentLink.transform.getBasis();
+    multiBody->setupRevolute(i, link.mass, link.inertia, parentIndex,
+                             link.transform.getRotation().inverse() * parentLink.transform.getRotation(),
+                             basis.transpose() * joint.transform.getBasis().getColumn(0),
+                             parentBasis.transpose() * (pivot - parentLink.transform.getOrigin()),
+                             basis.transpose() * (link.transform.getOrigin() - pivot),
+                             true);
   }
+  multiBody->finalizeMultiDof();
+  multiBody->setCanSleep(false);
+  multiBody->setHasSelfCollision(true);
+  multiBody->setLinearDamping(0);
+  multiBody->setAngularDamping(0);
+  multiBodyWorld->addMultiBody(multiBody, dynamicGroup, dynamicMask);
+
+  colliders.resize(links.size());
   for (int i = 0; i < links.size(); i++) {
-    const auto &link = links[i];
-    if (link.prisms.empty()) {
-      EXCEPT("No prism found for link with index " + std::to_string(i));
-    }
+    auto *collider = createCollider(multiBody, multiBodyLinks[i], shape->linkShapes[i],
+                                    links[i].transform, dynamicGroup, dynamicMask,
+                                    prismFriction, prismRestitution);
+    collider->setUserIndex2(i);
+    colliders[i] = collider;
   }
+
   for (int i = 0; i < joints.size(); i++) {
     const auto &joint = joints[i];
-    if ((joint.baseIndex < 0) || (joint.baseIndex >= links.size())) {
-      EXCEPT("Out of range base index (" +
-             std::to_string(joint.baseIndex) +
-             ") for joint with index " + std::to_string(i));
-    }
-    if ((joint.targetIndex < 0) || (joint.targetIndex >= links.size())) {
-      EXCEPT("Out of range target index (" +
-             std::to_string(joint.targetIndex) +
-             ") for joint with index " + std::to_string(i));
+    if (joint.lowerAngle > joint.upperAngle) {
+      continue;
     }
+    const auto &articulatedJoint = articulatedJoints[i];
+    const auto lowerAngle = btRadians(articulatedJoint.sign > 0 ? joint.lowerAngle : -joint.upperAngle);
+    const auto upperAngle = btRadians(articulatedJoint.sign > 0 ? joint.upperAngle : -joint.lowerAngle);
+    multiBodyWorld->addMultiBodyConstraint(
+      arena.create<btMultiBodyJointLimitConstraint>(multiBody, articulatedJoint.linkIndex,
+                                                    lowerAngle, upperAngle));
+  }
+
+  baseMultiBody = multiBody;
+}
+
+void TwistyEnv::updateLinkVelocities() {
+  const auto count = multiBody->getNumLinks() + 1;
+  linkAngularVelocities.resize(count);
+  linkLinearVelocities.resize(count);
+  multiBody->compTreeLinkVelocities(&linkAngularVelocities[0], &linkLinearVelocities[0]);
+}
+
+// Angle and speed follow the rigid-body backend: the angle of the target link relative to
+// the base link, and the x component of the target axis scaled by the target angular velocity.
+void TwistyEnv::articulatedJointState(int jointIndex, btScalar &angle, btScalar &speed) const {
+  const auto &articulatedJoint = articulatedJoints[jointIndex];
+  const auto &basis = colliders[joints[jointIndex].targetIndex]->getWorldTransform().getBasis();
+  const auto axis = basis * articulatedJoint.targetAxis;
+  const auto angularVelocity = basis * linkAngularVelocities[articulatedJoint.targetLinkIndex + 1];
+  angle = articulatedJoint.sign * multiBody->getJointPos(articulatedJoint.linkIndex);
+  speed = (axis * angularVelocity).x();
+}
+
+// Largest separation of the joint pivots as seen from the two linked bodies. Articulated
+// joints are exact by construction.
+btScalar TwistyEnv::jointError() const {
+  btScalar error = 0;
+  for (const auto *constraint : constraints) {
+    const auto pivotA = constraint->getRigidBodyA().getCenterOfMassTransform()
+                        * constraint->getFrameOffsetA().getOrigin();
+    const auto pivotB = constraint->getRigidBodyB().getCenterOfMassTransform()
+                        * constraint->getFrameOffsetB().getOrigin();
+    error = std::max(error, pivotA.distance(pivotB));
   }
+  return error;
 }
@@ -3,10 +3,15 @@
 #define TWISTYENV_H
 
 #include "GoalPhysicsEnv.h"
+#include "TwistyShape.h"
+
+#include <atomic>
 
 class TwistyEnv : public GoalPhysicsEnv {
 public:
-  TwistyEnv(const String &data);
+  TwistyEnv(const String &data, const PhysicsConfig &physicsConfig = PhysicsConfig());
+  TwistyEnv(const TwistyShapePtr &shape, const PhysicsConfig &physicsConfig = PhysicsConfig());
+  virtual ~TwistyEnv();
 
   virtual void reset() override;
 
@@ -14,28 +19,36 @@ public:
 
   virtual void applyForces(const Action &action) override;
   virtual float react(const Action &action, float timeStep) override;
+  virtual void tick(btScalar timeStep) override;
 
-  void parseData(const String &data);
-  void validateData() const;
+  void planArticulation();
+  void buildArticulation();
+  void updateLinkVelocities();
+  void articulatedJointState(int jointIndex, btScalar &angle, btScalar &speed) const;
+  btScalar jointError() const;
+  void refreshJointStates();
 
-  struct Prism {
-    btTransform transform;
-  };
-  struct Link {
-    float mass;
-    btVector3 inertia;
-    btTransform transform;
-    std::vector<Prism> prisms;
+  typedef TwistyShape::Prism Prism;
+  typedef TwistyShape::Link Link;
+  typedef TwistyShape::Joint Joint;
+  struct ArticulatedJoint {
+    int linkIndex; // multibody link rotated by the joint
+    btScalar sign; // -1 when the joint target is the multibody parent
+    int targetLinkIndex; // multibody link of the joint target, -1 for the base
+    btVector3 targetAxis; // joint axis in the target link frame
   };
-  struct Joint {
-    int baseIndex;
-    int targetIndex;
-    float lowerAngle;
-    float upperAngle;
-    float power;
-    btTransform transform;
+
+  // State of the active joints, in action order
+  struct JointStates {
+    btAlignedObjectArray<btVector3> axesA;
+    btAlignedObjectArray<btVector3> axesB;
+    std::vector<btScalar> angles;
+    std::vector<btScalar> speeds;
+    std::vector<btScalar> lowerLimits; // angles below are at the limit
+    std::vector<btScalar> upperLimits; // angles above are at the limit
   };
 
+  TwistyShapePtr shape;
   String name;
   int environmentSteps;
   float gravity;
@@ -50,14 +63,28 @@ public:
   float jointAtLimitCost;
   float driveCost;
   float stallTorqueCost;
-  std::vector<Link> links;
-  std::vector<Joint> joints;
+  const std::vector<Link> &links;
+  const std::vector<Joint> &joints;
   int activeJointCount;
+  std::vector<int> activeJoints;
+  JointStates jointStates;
+  bool jointStatesStale;
   int baseLinkIndex;
 
   btCollisionObject *groundObject;
+  std::vector<std::atomic<int>> groundContacts; // manifolds with contacts per link
   std::vector<btRigidBody*> bodies;
   std::vector<btGeneric6DofSpring2Constraint*> constraints;
+
+  btMultiBody *multiBody;
+  std::vector<btMultiBodyLinkCollider*> colliders;
+  std::vector<int> multiBodyLinks;
+  std::vector<int> articulationLinks;
+  std::vector<int> articulationParents;
+  std::vector<int> articulationJoints;
+  std::vector<ArticulatedJoint> articulatedJoints;
+  btAlignedObjectArray<btVector3> linkAngularVelocities;
+  btAlignedObjectArray<btVector3> linkLinearVelocities;
 };
 
 #endif // TWISTYENV_H
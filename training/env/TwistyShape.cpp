@@ -0,0 +1,339 @@
+
+#include "TwistyShape.h"
+#include "PhysicsEnv.h"
+#include "PrismShape.h"
+
+#include <mutex>
+
+static const float prismHeight = 1;
+static const float prismBase = 2 * prismHeight;
+static const float prismSide = std::sqrt(prismBase);
+static const float prismHalfHeight = prismHeight / 2;
+static const float prismHalfBase = prismBase / 2;
+static const float prismHalfSide = prismSide / 2;
+
+static const float prismMargin = 0.04;
+static const float prismMarginDiag = prismMargin * std::cos(SIMD_PI / 4);
+
+static const float prismCgH = prismHeight / 3;
+static const float prismCgDy = prismHalfHeight - prismCgH;
+
+static const int defaultEnvironmentSteps = 1000;
+static const float defaultGravity = -9.81;
+static const float defaultTargetDistance = 30;
+static const float defaultGroundFriction = 0.8;
+static const float defaultPrismFriction = 0.8;
+static const float defaultGroundRestitution = 0;
+static const float defaultPrismRestitution = 0;
+
+static const float defaultAdvanceReward = 1;
+static const float defaultAliveReward = 0;
+static const float defaultForwardReward = 0;
+static const float defaultJointAtLimitCost = -10;
+static const float defaultDriveCost = 0;
+static const float defaultStallTorqueCost = 0;
+
+static const float prismCollisionHalfBase = prismHalfBase - 2 * prismMarginDiag - prismMargin;
+static const float prismCollisionBottom = -prismHalfHeight + prismCgDy + prismMargin;
+static const float prismCollisionTop = prismHalfHeight + prismCgDy - 2 * prismMarginDiag;
+static const float prismCollisionHalfSide = prismHalfSide - prismMargin;
+static const float linkPairMargin = 0.1;
+
+static const int collisionPoolMinimum = 64;
+static const int collisionPoolPrismEntries = 4;
+
+template<typename T>
+static T readValue(std::istringstream &stream) {
+  T value;
+  stream >> value;
+  return value;
+}
+
+static btVector3 readVector(std::istringstream &stream) {
+  return {readValue<btScalar>(stream), readValue<btScalar>(stream), readValue<btScalar>(stream)};
+}
+
+static btQuaternion readQuaternion(std::istringstream &stream) {
+  return {readValue<btScalar>(stream), readValue<btScalar>(stream),
+          readValue<btScalar>(stream), readValue<btScalar>(stream)};
+}
+
+static btTransform readTransform(std::istringstream &stream) {
+  const auto position = readVector(stream);
+  auto orientation = readQuaternion(stream);
+  orientation.normalize();
+  return btTransform(orientation, position);
+}
+
+TwistyShapePtr TwistyShape::acquire(const String &data) {
+  static std::mutex mutex;
+  static Map<size_t, std::weak_ptr<const TwistyShape>> library;
+  const auto key = std::hash<String>()(data);
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto entry = library.begin(); entry != library.end();) {
+    entry = entry->second.expired() ? library.erase(entry) : std::next(entry);
+  }
+  auto shape = library[key].lock();
+  if ((shape == nullptr) || (shape->data != data)) {
+    shape = std::make_shared<const TwistyShape>(data);
+    library[key] = shape;
+  }
+  return shape;
+}
+
+TwistyShape::TwistyShape(const String &data)
+    : data(data)
+    , timeStep(PhysicsEnv::defaultTimeStep)
+    , frameSteps(PhysicsEnv::defaultFrameSteps)
+    , environmentSteps(defaultEnvironmentSteps)
+    , gravity(defaultGravity)
+    , targetDistance(defaultTargetDistance)
+    , groundFriction(defaultGroundFriction)
+    , prismFriction(defaultPrismFriction)
+    , groundRestitution(defaultGroundRestitution)
+    , prismRestitution(defaultPrismRestitution)
+    , advanceReward(defaultAdvanceReward)
+    , aliveReward(defaultAliveReward)
+    , forwardReward(defaultForwardReward)
+    , jointAtLimitCost(defaultJointAtLimitCost)
+    , driveCost(defaultDriveCost)
+    , stallTorqueCost(defaultStallTorqueCost)
+    , hasProfile(false)
+    , activeJointCount(0)
+    , baseLinkIndex(-1)
+    , prismShape(nullptr)
+    , linkPairFilter(nullptr)
+    , collisionPoolSize(collisionPoolMinimum) {
+  parseData(data);
+  validateData();
+  createShapes();
+  pruneLinkPairs();
+}
+
+TwistyShape::~TwistyShape() {
+  delete linkPairFilter;
+  for (auto *linkShape : linkShapes) {
+    delete linkShape;
+  }
+  delete prismShape;
+}
+
+// Link compounds keep their dynamic AABB trees, which are only read during collision.
+void TwistyShape::createShapes() {
+  prismShape = new PrismShape(prismCollisionHalfBase, prismCollisionBottom, prismCollisionTop,
+                              prismCollisionHalfSide, prismMargin);
+  for (const auto &link : links) {
+    auto *linkShape = new btCompoundShape();
+    for (const auto &prism : link.prisms) {
+      linkShape->addChildShape(prism.transform, prismShape);
+    }
+    linkShapes.push_back(linkShape);
+    collisionPoolSize += collisionPoolPrismEntries * link.prisms.size();
+  }
+}
+
+// Excludes the link pairs that can never touch: jointed pairs, which are never collided,
+// and pairs whose bounding spheres stay apart over every joint angle. The sphere of the far
+// link is swept back along the joint path, each joint widening it to cover the arc its
+// center travels over the joint range. Joint loops only restrict the motion further, so
+// following a single path keeps the test conservative.
+void TwistyShape::pruneLinkPairs() {
+  const int linkCount = links.size();
+  std::vector<btVector3> centers(linkCount);
+  std::vector<btScalar> radii(linkCount);
+  for (int i = 0; i < linkCount; i++) {
+    btVector3 center;
+    linkShapes[i]->getBoundingSphere(center, radii[i]);
+    centers[i] = links[i].transform * center;
+  }
+
+  std::vector<std::vector<int>> linkJoints(linkCount);
+  for (int i = 0; i < joints.size(); i++) {
+    linkJoints[joints[i].baseIndex].push_back(i);
+    linkJoints[joints[i].targetIndex].push_back(i);
+  }
+
+  linkPairFilter = new LinkPairFilter(linkCount);
+  for (const auto &joint : joints) {
+    linkPairFilter->exclude(joint.baseIndex, joint.targetIndex);
+  }
+
+  std::vector<int> previousJoints(linkCount);
+  for (int i = 0; i < linkCount; i++) {
+    previousJoints.assign(linkCount, -2);
+    previousJoints[i] = -1;
+    std::vector<int> queue = {i};
+    for (int q = 0; q < queue.size(); q++) {
+      for (const auto jointIndex : linkJoints[queue[q]]) {
+        const auto &joint = joints[jointIndex];
+        const auto linkIndex = (joint.baseIndex == queue[q]) ? joint.targetIndex : joint.baseIndex;
+        if (previousJoints[linkIndex] == -2) {
+          previousJoints[linkIndex] = jointIndex;
+          queue.push_back(linkIndex);
+        }
+      }
+    }
+
+    for (int j = i + 1; j < linkCount; j++) {
+      if ((previousJoints[j] == -2) || linkPairFilter->excluded(i, j)) {
+        continue;
+      }
+      auto center = centers[j];
+      auto radius = radii[j];
+      for (int linkIndex = j; linkIndex != i;) {
+        const auto &joint = joints[previousJoints[linkIndex]];
+        const auto pivot = joint.transform.getOrigin();
+        const auto axis = joint.transform.getBasis().getColumn(0);
+        btScalar halfRange = SIMD_PI;
+        btScalar middle = 0;
+        if (joint.lowerAngle <= joint.upperAngle) {
+          halfRange = btRadians(joint.upperAngle - joint.lowerAngle) / 2;
+          middle = btRadians(joint.upperAngle + joint.lowerAngle) / 2;
+        }
+        if (linkIndex == joint.baseIndex) {
+          middle = -middle;
+        }
+        const auto offset = center - pivot;
+        const auto axial = axis * offset.dot(axis);
+        const auto radial = offset - axial;
+        const auto distance = radial.length();
+        if (halfRange >= SIMD_HALF_PI) {
+          center = pivot + axial;
+          radius += distance;
+        } else {
+          center = pivot + axial + radial.rotate(axis, middle) * std::cos(halfRange);
+          radius += distance * std::sin(halfRange);
+        }
+        linkIndex = (linkIndex == joint.baseIndex) ? joint.targetIndex : joint.baseIndex;
+      }
+      if (center.distance(centers[i]) > radius + radii[i] + linkPairMargin) {
+        linkPairFilter->exclude(i, j);
+      }
+    }
+  }
+}
+
+// The profile from the shape data applies unless the config overrides it, and the collision
+// pools are sized to the shape unless the config sizes them.
+PhysicsConfig TwistyShape::physicsConfig(const PhysicsConfig &config) const {
+  auto result = config;
+  if (hasProfile && !config.profileOverride) {
+    result.profile = profile;
+  }
+  if (result.collisionPoolSize == 0) {
+    result.collisionPoolSize = collisionPoolSize;
+  }
+  return result;
+}
+
+void TwistyShape::parseData(const String &data) {
+  if (data.empty()) {
+    EXCEPT("Data must be specified");
+  }
+
+  String line;
+  auto lines = std::istringstream(data);
+  while (std::getline(lines, line)) {
+    if (line.length() < 2) {
+      EXCEPT("Invalid line: '" + line + "'");
+    }
+    const auto type = line[0];
+    std::istringstream stream(line.substr(2));
+    switch (type) {
+    case 'o':
+      stream >> name;
+      break;
+    case 's':
+      timeStep = readValue<float>(stream);
+      frameSteps = readValue<int>(stream);
+      environmentSteps = readValue<int>(stream);
+      gravity = readValue<float>(stream);
+      targetDistance = readValue<float>(stream);
+      groundFriction = readValue<float>(stream);
+      prismFriction = readValue<float>(stream);
+      groundRestitution = readValue<float>(stream);
+      prismRestitution = readValue<float>(stream);
+      break;
+    case 'f':
+      hasProfile = true;
+      profile = PhysicsEnv::parseProfile(stream);
+      break;
+    case 'c':
+      advanceReward = readValue<float>(stream);
+      aliveReward = readValue<float>(stream);
+      forwardReward = readValue<float>(stream);
+      jointAtLimitCost = readValue<float>(stream);
+      driveCost = readValue<float>(stream);
+      stallTorqueCost = readValue<float>(stream);
+      break;
+    case 'l':
+      links.push_back({
+        readValue<float>(stream), // mass
+        readVector(stream), // inertia
+        readTransform(stream), // transform
+        {} // prisms
+      });
+      break;
+    case 'p':
+      if (links.empty()) {
+        EXCEPT("No link");
+      }
+      links.back().prisms.push_back({
+        readTransform(stream) // transform
+      });
+      break;
+    case 'j':
+      joints.push_back({
+        readValue<int>(stream), // base index
+        readValue<int>(stream), // target index
+        readValue<float>(stream), // lower angle
+        readValue<float>(stream), // upper angle
+        readValue<float>(stream), // power
+        readTransform(stream) // transform
+      });
+      break;
+    case 'b':
+      if (baseLinkIndex != -1) {
+        EXCEPT("Multiple bases not supported");
+      }
+      baseLinkIndex = readValue<int>(stream);
+      break;
+    default:
+      EXCEPT("Invalid type: '" + String(1, type) + "'");
+    }
+  }
+
+  for (const auto &joint : joints) {
+    if (joint.power != 0) {
+      activeJointCount++;
+    }
+  }
+}
+
+void TwistyShape::validateData() const {
+  if (baseLinkIndex == -1) {
+    EXCEPT("No base found");
+  }
+  if ((baseLinkIndex < 0) || (baseLinkIndex >= links.size())) {
+    EXCEPT("Out of range base link index (" + std::to_string(baseLinkIndex) + ")");
+  }
+  for (int i = 0; i < links.size(); i++) {
+    const auto &link = links[i];
+    if (link.prisms.empty()) {
+      EXCEPT("No prism found for link with index " + std::to_string(i));
+    }
+  }
+  for (int i = 0; i < joints.size(); i++) {
+    const auto &joint = joints[i];
+    if ((joint.baseIndex < 0) || (joint.baseIndex >= links.size())) {
+      EXCEPT("Out of range base index (" +
+             std::to_string(joint.baseIndex) +
+             ") for joint with index " + std::to_string(i));
+    }
+    if ((joint.targetIndex < 0) || (joint.targetIndex >= links.size())) {
+      EXCEPT("Out of range target index (" +
+             std::to_string(joint.targetIndex) +
+             ") for joint with index " + std::to_string(i));
+    }
+  }
+}
@@ -0,0 +1,83 @@
+
+#ifndef TWISTYSHAPE_H
+#define TWISTYSHAPE_H
+
+#include "Config.h"
+#include "LinkPairFilter.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#include "BulletCollision/CollisionShapes/btCompoundShape.h"
+#pragma clang diagnostic pop
+
+class TwistyShape;
+
+typedef std::shared_ptr<const TwistyShape> TwistyShapePtr;
+
+// Parsed shape data with its collision geometry and link pair filter. Read-only once built,
+// and shared by every environment created from the same shape data.
+class TwistyShape {
+public:
+  struct Prism {
+    btTransform transform;
+  };
+  struct Link {
+    float mass;
+    btVector3 inertia;
+    btTransform transform;
+    std::vector<Prism> prisms;
+  };
+  struct Joint {
+    int baseIndex;
+    int targetIndex;
+    float lowerAngle;
+    float upperAngle;
+    float power;
+    btTransform transform;
+  };
+
+  static TwistyShapePtr acquire(const String &data);
+
+  TwistyShape(const String &data);
+  TwistyShape(const TwistyShape &shape) = delete;
+  ~TwistyShape();
+
+  void parseData(const String &data);
+  void validateData() const;
+
+  void createShapes();
+  void pruneLinkPairs();
+
+  PhysicsConfig physicsConfig(const PhysicsConfig &config) const;
+
+  String data;
+  String name;
+  float timeStep;
+  int frameSteps;
+  int environmentSteps;
+  float gravity;
+  float targetDistance;
+  float groundFriction;
+  float prismFriction;
+  float groundRestitution;
+  float prismRestitution;
+  float advanceReward;
+  float aliveReward;
+  float forwardReward;
+  float jointAtLimitCost;
+  float driveCost;
+  float stallTorqueCost;
+  bool hasProfile;
+  PhysicsProfile profile;
+  std::vector<Link> links;
+  std::vector<Joint> joints;
+  int activeJointCount;
+  int baseLinkIndex;
+
+  btCollisionShape *prismShape;
+  std::vector<btCompoundShape*> linkShapes;
+  LinkPairFilter *linkPairFilter;
+  int collisionPoolSize;
+};
+
+#endif // TWISTYSHAPE_H
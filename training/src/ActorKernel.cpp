@@ -0,0 +1,66 @@
+
+#include "ActorKernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+ActorKernel::ActorKernel(const Actor &actor) {
+  pack(actor);
+}
+
+void ActorKernel::pack(const Actor &actor) {
+  torch::NoGradGuard noGradGuard;
+
+  Array<torch::nn::Linear> linears;
+  for (const auto &module : actor.net->children()) {
+    if (auto linear = std::dynamic_pointer_cast<torch::nn::LinearImpl>(module)) {
+      linears.emplace_back(linear);
+    }
+  }
+  linears.push_back(actor.muLayer);
+
+  layers.resize(linears.size());
+  kernelLayers.resize(linears.size());
+  int bufferLength = 0;
+  for (size_t l = 0; l < linears.size(); l++) {
+    const auto weight = linears[l]->weight.contiguous();
+    const auto bias = linears[l]->bias.contiguous();
+    const auto outputLength = static_cast<int>(weight.size(0));
+    const auto inputLength = static_cast<int>(weight.size(1));
+    const auto paddedOutputLength = (outputLength + DenseKernel::outputPadding - 1) /
+                                    DenseKernel::outputPadding * DenseKernel::outputPadding;
+
+    auto &layer = layers[l];
+    layer.inputLength = inputLength;
+    layer.outputLength = outputLength;
+    layer.paddedOutputLength = paddedOutputLength;
+    layer.activation = (l + 1 < linears.size());
+    layer.weights.assign(static_cast<size_t>(inputLength) * paddedOutputLength, 0);
+    layer.biases.assign(paddedOutputLength, 0);
+
+    const auto weightAccessor = weight.accessor<float, 2>();
+    for (int o = 0; o < outputLength; o++) {
+      for (int i = 0; i < inputLength; i++) {
+        layer.weights[static_cast<size_t>(i) * paddedOutputLength + o] = weightAccessor[o][i];
+      }
+    }
+    std::copy_n(bias.data_ptr<float>(), outputLength, layer.biases.begin());
+
+    kernelLayers[l] = {inputLength, paddedOutputLength, layer.activation,
+                       layer.weights.data(), layer.biases.data()};
+    bufferLength = std::max(bufferLength, std::max(inputLength, paddedOutputLength));
+  }
+
+  actionLength = layers.back().outputLength;
+  input.assign(bufferLength, 0);
+  output.assign(bufferLength, 0);
+}
+
+void ActorKernel::forward(const float *observation, float *action) {
+  std::copy_n(observation, layers.front().inputLength, input.begin());
+  const auto *mu = DenseKernel::forward(kernelLayers.data(), kernelLayers.size(),
+                                        input.data(), output.data());
+  for (int i = 0; i < actionLength; i++) {
+    action[i] = std::tanh(mu[i]);
+  }
+}
@@ -0,0 +1,78 @@
+
+#ifndef ACTORKERNEL_H
+#define ACTORKERNEL_H
+
+#include "Model.h"
+#include "DenseKernel.h"
+
+#include <cstdlib>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+template<typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  typedef T value_type;
+
+  AlignedAllocator() = default;
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  template<typename U>
+  struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  T* allocate(size_t count) {
+    const auto size = (count * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+#ifdef _MSC_VER
+    auto *data = static_cast<T*>(_aligned_malloc(size, Alignment));
+#else
+    auto *data = static_cast<T*>(std::aligned_alloc(Alignment, size));
+#endif
+    if (data == nullptr) {
+      throw std::bad_alloc();
+    }
+    return data;
+  }
+
+  void deallocate(T *data, size_t) {
+#ifdef _MSC_VER
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+  }
+
+  bool operator==(const AlignedAllocator&) const { return true; }
+  bool operator!=(const AlignedAllocator&) const { return false; }
+};
+
+typedef std::vector<float, AlignedAllocator<float>> AlignedFloatArray;
+
+class ActorKernel {
+public:
+  struct Layer {
+    int inputLength;
+    int outputLength;
+    int paddedOutputLength;
+    bool activation;
+    AlignedFloatArray weights;
+    AlignedFloatArray biases;
+  };
+
+  ActorKernel() = default;
+  ActorKernel(const Actor &actor);
+
+  void pack(const Actor &actor);
+
+  void forward(const float *observation, float *action);
+
+  Array<Layer> layers;
+  Array<DenseKernel::Layer> kernelLayers;
+  int actionLength = 0;
+  AlignedFloatArray input;
+  AlignedFloatArray output;
+};
+
+#endif // ACTORKERNEL_H
@@ -0,0 +1,66 @@
+
+#include "ActorSnapshot.h"
+
+#include <algorithm>
+#include <thread>
+
+static int countParameters(const Actor &actor) {
+  int count = 0;
+  for (const auto &parameter : actor.parameters()) {
+    count += parameter.numel();
+  }
+  return count;
+}
+
+static void storeParameters(const Actor &actor, float *data) {
+  for (const auto &parameter : actor.parameters()) {
+    const auto contiguousParameter = parameter.contiguous();
+    data = std::copy_n(contiguousParameter.data_ptr<float>(), contiguousParameter.numel(), data);
+  }
+}
+
+static void loadParameters(const float *data, Actor &actor) {
+  for (auto &parameter : actor.parameters()) {
+    std::copy_n(data, parameter.numel(), parameter.data_ptr<float>());
+    data += parameter.numel();
+  }
+}
+
+ActorSnapshot::ActorSnapshot(const Actor &actor)
+    : parameterCount(countParameters(actor))
+    , buffers{{Array<float>(parameterCount), Array<float>(parameterCount)}}
+    , published(0)
+    , version(0) {
+  readers[0] = 0;
+  readers[1] = 0;
+  storeParameters(actor, buffers[0].data());
+}
+
+void ActorSnapshot::publish(const Actor &actor) {
+  const auto slot = 1 - published.load();
+  while (readers[slot].load() > 0) {
+    std::this_thread::yield();
+  }
+  storeParameters(actor, buffers[slot].data());
+  published.store(slot);
+  version++;
+}
+
+bool ActorSnapshot::acquire(Actor &actor, int &version) {
+  const auto currentVersion = this->version.load();
+  if (currentVersion == version) {
+    return false;
+  }
+  while (true) {
+    const auto slot = published.load();
+    readers[slot]++;
+    if (published.load() == slot) {
+      loadParameters(buffers[slot].data(), actor);
+      readers[slot]--;
+      break;
+    }
+    readers[slot]--;
+  }
+  version = currentVersion;
+  return true;
+}
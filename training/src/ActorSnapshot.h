@@ -0,0 +1,24 @@
+
+#ifndef ACTORSNAPSHOT_H
+#define ACTORSNAPSHOT_H
+
+#include "Model.h"
+
+#include <atomic>
+
+class ActorSnapshot {
+public:
+  ActorSnapshot(const Actor &actor);
+  ActorSnapshot(const ActorSnapshot &snapshot) = delete;
+
+  void publish(const Actor &actor);
+  bool acquire(Actor &actor, int &version);
+
+  int parameterCount;
+  std::array<Array<float>, 2> buffers;
+  std::array<std::atomic<int>, 2> readers;
+  std::atomic<int> published;
+  std::atomic<int> version;
+};
+
+#endif // ACTORSNAPSHOT_H
@@ -0,0 +1,95 @@
+
+#include "ActorWorker.h"
+
+ActorWorker::ActorWorker(const Config &config, VectorEnvironmentPtr environment, const Actor &actor,
+                         ActorSnapshotPtr snapshot, TransitionQueuePtr queue, int streamOffset)
+    : config(config)
+    , environment(environment)
+    , snapshot(snapshot)
+    , queue(queue)
+    , streamOffset(streamOffset)
+    , actor(std::dynamic_pointer_cast<Actor>(actor.clone()))
+    , actorKernel(*this->actor)
+    , actorVersion(snapshot->version)
+    , advance(0)
+    , values(0.0, environment->size())
+    , running(true) {
+  thread = std::thread(&ActorWorker::run, this);
+}
+
+ActorWorker::~ActorWorker() {
+  running = false;
+  thread.join();
+}
+
+void ActorWorker::run() {
+  while (running) {
+    step();
+  }
+}
+
+void ActorWorker::step() {
+  if (snapshot->acquire(*actor, actorVersion)) {
+    actorKernel.pack(*actor);
+  }
+
+  environment->restart();
+
+  torch::Tensor action;
+  if (advance * config.workerCount < config.randomSteps) {
+    action = environment->randomAction();
+  } else {
+    action = torch::empty({environment->size(), environment->actionLength}, torch::kFloat32);
+    const auto *observationData = environment->observation.data_ptr<float>();
+    auto *actionData = action.data_ptr<float>();
+    for (int i = 0; i < environment->size(); i++) {
+      actorKernel.forward(observationData + i * environment->observationLength,
+                          actionData + i * environment->actionLength);
+    }
+  }
+
+  environment->step(action);
+
+  const auto *observationData = environment->observation.data_ptr<float>();
+  const auto *actionData = action.data_ptr<float>();
+  const auto *nextObservationData = environment->nextObservation.data_ptr<float>();
+  const auto observationLength = environment->observationLength;
+  const auto actionLength = environment->actionLength;
+  PlayStatistics stepStatistics;
+  for (int i = 0; i < environment->size(); i++) {
+    const auto reward = environment->reward[i];
+    while (!queue->push(streamOffset + i, observationData + i * observationLength,
+                        actionData + i * actionLength, reward,
+                        nextObservationData + i * observationLength,
+                        environment->done[i])) {
+      if (!running) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+
+    values[i] += reward;
+    stepStatistics.moveCount++;
+    if (environment->finished[i]) {
+      stepStatistics.gameCount++;
+      stepStatistics.totalValue += values[i];
+      values[i] = 0;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    statistics.gameCount += stepStatistics.gameCount;
+    statistics.moveCount += stepStatistics.moveCount;
+    statistics.totalValue += stepStatistics.totalValue;
+  }
+
+  advance += environment->size();
+}
+
+PlayStatistics ActorWorker::collectStatistics() {
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  const auto collectedStatistics = statistics;
+  statistics = {};
+  return collectedStatistics;
+}
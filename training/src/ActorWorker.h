@@ -0,0 +1,42 @@
+
+#ifndef ACTORWORKER_H
+#define ACTORWORKER_H
+
+#include "VectorEnvironment.h"
+#include "ActorSnapshot.h"
+#include "ActorKernel.h"
+#include "TransitionQueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+class ActorWorker {
+public:
+  ActorWorker(const Config &config, VectorEnvironmentPtr environment, const Actor &actor,
+              ActorSnapshotPtr snapshot, TransitionQueuePtr queue, int streamOffset);
+  ActorWorker(const ActorWorker &worker) = delete;
+  ~ActorWorker();
+
+  void run();
+  void step();
+
+  PlayStatistics collectStatistics();
+
+  Config config;
+  VectorEnvironmentPtr environment;
+  ActorSnapshotPtr snapshot;
+  TransitionQueuePtr queue;
+  int streamOffset;
+  ActorPtr actor;
+  ActorKernel actorKernel;
+  int actorVersion;
+  int advance;
+  FloatValArray values;
+  PlayStatistics statistics;
+  std::mutex statisticsMutex;
+  std::atomic<bool> running;
+  std::thread thread;
+};
+
+#endif // ACTORWORKER_H
@@ -0,0 +1,50 @@
+
+#ifndef BINARYSTREAM_H
+#define BINARYSTREAM_H
+
+#include "Types.h"
+
+template<typename T>
+void writeBinary(std::ostream &stream, const T &value) {
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+void writeBinary(std::ostream &stream, const T *values, size_t count) {
+  stream.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+template<typename T>
+T readBinary(std::istream &stream) {
+  T value;
+  if (!stream.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+    EXCEPT("Unexpected end of stream");
+  }
+  return value;
+}
+
+template<typename T>
+void readBinary(std::istream &stream, T *values, size_t count) {
+  if (!stream.read(reinterpret_cast<char*>(values), count * sizeof(T))) {
+    EXCEPT("Unexpected end of stream");
+  }
+}
+
+template<typename Engine>
+void writeEngine(std::ostream &stream, const Engine &engine) {
+  std::ostringstream engineStream;
+  engineStream << engine;
+  const auto state = engineStream.str();
+  writeBinary<int64_t>(stream, state.size());
+  writeBinary(stream, state.data(), state.size());
+}
+
+template<typename Engine>
+void readEngine(std::istream &stream, Engine &engine) {
+  String state(readBinary<int64_t>(stream), '\0');
+  readBinary(stream, &state[0], state.size());
+  std::istringstream engineStream(state);
+  engineStream >> engine;
+}
+
+#endif // BINARYSTREAM_H
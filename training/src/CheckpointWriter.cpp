@@ -0,0 +1,117 @@
+
+#include "CheckpointWriter.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+CheckpointWriter::CheckpointWriter()
+    : writing(false)
+    , running(true) {
+  thread = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  condition.notify_all();
+  thread.join();
+}
+
+void CheckpointWriter::submit(const String &filePath, String content,
+                              std::function<void()> written) {
+  submit(filePath, [content = std::move(content)]() {
+    return content;
+  }, std::move(written));
+}
+
+// The content is produced on the writer thread, so that encoding it does not stall the caller.
+// Files are written in submission order and written is only called once the file is in place.
+void CheckpointWriter::submit(const String &filePath, std::function<String()> produceContent,
+                              std::function<void()> written) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find_if(pending.begin(), pending.end(), [&filePath](const auto &file) {
+      return file.path == filePath;
+    });
+    if (it != pending.end()) {
+      pending.erase(it);
+    }
+    pending.push_back({filePath, std::move(produceContent), std::move(written)});
+  }
+  condition.notify_all();
+}
+
+void CheckpointWriter::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  condition.wait(lock, [this]() {
+    return pending.empty() && !writing;
+  });
+}
+
+void CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    condition.wait(lock, [this]() {
+      return !pending.empty() || !running;
+    });
+    if (pending.empty()) {
+      break;
+    }
+
+    auto file = std::move(pending.front());
+    pending.pop_front();
+    writing = true;
+    lock.unlock();
+    try {
+      write(file.path, file.produceContent());
+      if (file.written) {
+        file.written();
+      }
+    } catch (const std::exception &exception) {
+      std::cerr << "Failed to write " << file.path << ": " << exception.what() << std::endl;
+    }
+    lock.lock();
+    writing = false;
+    condition.notify_all();
+  }
+}
+
+void CheckpointWriter::write(const String &filePath, const String &content) {
+  const auto temporaryFilePath = filePath + ".tmp";
+#ifdef _WIN32
+  {
+    std::ofstream file(temporaryFilePath, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size());
+    file.close();
+    if (!file) {
+      EXCEPT("Failed to write " + temporaryFilePath);
+    }
+  }
+#else
+  const auto descriptor = ::open(temporaryFilePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0) {
+    EXCEPT("Failed to open " + temporaryFilePath);
+  }
+  size_t offset = 0;
+  while (offset < content.size()) {
+    const auto count = ::write(descriptor, content.data() + offset, content.size() - offset);
+    if (count < 0) {
+      ::close(descriptor);
+      EXCEPT("Failed to write " + temporaryFilePath);
+    }
+    offset += count;
+  }
+  if ((::fsync(descriptor) != 0) || (::close(descriptor) != 0)) {
+    EXCEPT("Failed to flush " + temporaryFilePath);
+  }
+#endif
+  std::filesystem::rename(temporaryFilePath, filePath);
+}
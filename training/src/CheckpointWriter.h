@@ -0,0 +1,42 @@
+
+#ifndef CHECKPOINTWRITER_H
+#define CHECKPOINTWRITER_H
+
+#include "Types.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class CheckpointWriter {
+public:
+  CheckpointWriter();
+  CheckpointWriter(const CheckpointWriter &checkpointWriter) = delete;
+  ~CheckpointWriter();
+
+  struct File {
+    String path;
+    std::function<String()> produceContent;
+    std::function<void()> written;
+  };
+
+  void submit(const String &filePath, String content, std::function<void()> written = nullptr);
+  void submit(const String &filePath, std::function<String()> produceContent,
+              std::function<void()> written = nullptr);
+  void wait();
+
+  void run();
+
+  static void write(const String &filePath, const String &content);
+
+  std::deque<File> pending;
+  bool writing;
+  bool running;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::thread thread;
+};
+
+#endif // CHECKPOINTWRITER_H
@@ -1,36 +1,137 @@
 
 #include "Coach.h"
 #include "ReplayBuffer.h"
+#include "ActorSnapshot.h"
+#include "ActorWorker.h"
+#include "Learner.h"
+#include "TransitionQueue.h"
 
-Coach::Coach(const Config &config, EnvironmentPtr environment, NetworkPtr network)
+#include <thread>
+
+static const int transitionQueueCapacity = 1 << 14;
+
+Coach::Coach(const Config &config, VectorEnvironmentPtr environment, NetworkPtr network)
     : config(config)
     , environment(environment)
     , network(network)
-    , replayBuffer(std::make_shared<ReplayBuffer>(config))
-    , advance(0) {
+    , replayBuffer(std::make_shared<ReplayBuffer>(config, environment->observationLength,
+                                                 environment->actionLength))
+    , advance(0)
+    , values(0.0, environment->size())
+    , trainCount(0)
+    , publishedTrainCount(0) {
+}
+
+Coach::Coach(const Config &config, const Array<VectorEnvironmentPtr> &environments, NetworkPtr network)
+    : config(config)
+    , network(network)
+    , replayBuffer(std::make_shared<ReplayBuffer>(config, environments.front()->observationLength,
+                                                 environments.front()->actionLength))
+    , advance(0)
+    , trainCount(0)
+    , publishedTrainCount(0)
+    , snapshot(std::make_shared<ActorSnapshot>(*network->model->actor))
+    , queue(std::make_shared<TransitionQueue>(transitionQueueCapacity,
+                                              environments.front()->observationLength,
+                                              environments.front()->actionLength)) {
+  int streamOffset = 0;
+  for (const auto &workerEnvironment : environments) {
+    workers.push_back(std::make_shared<ActorWorker>(config, workerEnvironment, *network->model->actor,
+                                                    snapshot, queue, streamOffset));
+    streamOffset += workerEnvironment->size();
+  }
 }
 
-float Coach::step() {
-  if (environment->done || environment->timeout()) {
-    environment->restart();
+int Coach::step() {
+  if (!workers.empty()) {
+    return collect();
   }
 
-  auto observation = environment->observation;
-  auto action = (advance < config.randomSteps
-                 ? environment->randomAction()
-                 : network->predict(observation));
+  environment->restart();
 
-  const auto reward = environment->step(action);
-  auto nextObservation = environment->observation;
-  replayBuffer->append(std::make_shared<Sample>(std::move(observation),
-                       std::move(action), reward, std::move(nextObservation),
-                       environment->done));
+  const auto action = (advance < config.randomSteps
+                       ? environment->randomAction()
+                       : network->predict(environment->observation));
 
-  advance++;
-  return reward;
+  environment->step(action);
+
+  const auto *observationData = environment->observation.data_ptr<float>();
+  const auto *actionData = action.data_ptr<float>();
+  const auto *nextObservationData = environment->nextObservation.data_ptr<float>();
+  const auto observationLength = environment->observationLength;
+  const auto actionLength = environment->actionLength;
+  for (int i = 0; i < environment->size(); i++) {
+    const auto reward = environment->reward[i];
+    replayBuffer->append(i, observationData + i * observationLength,
+                         actionData + i * actionLength, reward,
+                         nextObservationData + i * observationLength,
+                         environment->done[i]);
+
+    values[i] += reward;
+    statistics.moveCount++;
+    if (environment->finished[i]) {
+      statistics.gameCount++;
+      statistics.totalValue += values[i];
+      values[i] = 0;
+    }
+  }
+
+  advance += environment->size();
+  return environment->size();
 }
 
 ActorCriticLosses Coach::train() {
-  const auto samples = replayBuffer->sampleBatch();
-  return network->train(samples);
+  if (replayBuffer->empty()) {
+    return {0, 0};
+  }
+  trainCount++;
+  auto &batch = replayBuffer->sampleBatch();
+  const auto losses = network->train(batch);
+  replayBuffer->updatePriorities(batch);
+  return losses;
+}
+
+int Coach::collect() {
+  int count = 0;
+  if (learner != nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    count = learner->transitionCount - advance;
+  } else {
+    if (trainCount != publishedTrainCount) {
+      snapshot->publish(*network->model->actor);
+      publishedTrainCount = trainCount;
+    }
+
+    count = queue->drain(*replayBuffer, transitionQueueCapacity);
+    if (count == 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  for (auto &worker : workers) {
+    const auto workerStatistics = worker->collectStatistics();
+    statistics.gameCount += workerStatistics.gameCount;
+    statistics.moveCount += workerStatistics.moveCount;
+    statistics.totalValue += workerStatistics.totalValue;
+  }
+
+  advance += count;
+  return count;
+}
+
+void Coach::startLearner(int trainingStartSteps) {
+  if (workers.empty()) {
+    EXCEPT("Learner requires actor workers");
+  }
+  if (learner == nullptr) {
+    learner = std::make_shared<Learner>(config, network, replayBuffer, queue,
+                                        snapshot, trainingStartSteps, advance, trainCount);
+  }
+}
+
+std::unique_lock<std::mutex> Coach::lockNetwork() {
+  if (learner == nullptr) {
+    return {};
+  }
+  return std::unique_lock<std::mutex>(learner->networkMutex);
 }
@@ -2,23 +2,37 @@
 #ifndef COACH_H
 #define COACH_H
 
-#include "Environment.h"
+#include "VectorEnvironment.h"
 #include "Network.h"
 
+#include <mutex>
+
 class Coach {
 public:
-  Coach(const Config &config, EnvironmentPtr environment, NetworkPtr network);
+  Coach(const Config &config, VectorEnvironmentPtr environment, NetworkPtr network);
+  Coach(const Config &config, const Array<VectorEnvironmentPtr> &environments, NetworkPtr network);
 
-  float step();
+  int step();
   ActorCriticLosses train();
 
-  Action randomAction(int actionLength);
+  int collect();
+
+  void startLearner(int trainingStartSteps);
+  std::unique_lock<std::mutex> lockNetwork();
 
   Config config;
-  EnvironmentPtr environment;
+  VectorEnvironmentPtr environment;
   NetworkPtr network;
   ReplayBufferPtr replayBuffer;
   int advance;
+  FloatValArray values;
+  PlayStatistics statistics;
+  int trainCount;
+  int publishedTrainCount;
+  ActorSnapshotPtr snapshot;
+  TransitionQueuePtr queue;
+  Array<ActorWorkerPtr> workers;
+  LearnerPtr learner;
 };
 
 #endif // COACH_H
@@ -4,14 +4,45 @@
 
 #include "Types.h"
 
+struct PhysicsProfile {
+  PhysicsBroadphase broadphase = PhysicsBroadphase::Dbvt;
+  PhysicsSolver solver = PhysicsSolver::SequentialImpulse;
+  int solverIterations = 10;
+  bool splitImpulse = true;
+  float warmstartingFactor = 0.85;
+};
+
+struct PhysicsConfig {
+  PhysicsBackend backend = PhysicsBackend::RigidBody;
+  int threadCount = 0;
+  PhysicsProfile profile;
+  bool profileOverride = false; // profile takes precedence over the one in the shape data
+  int collisionPoolSize = 0; // manifold and collision algorithm pool entries, 0 sizes to the shape
+};
+
 struct Config {
   float discount = 0.99;
   int batchSize = 100;
   int randomSteps = 10000;
   int replayBufferSize = 1000000;
+  String replayStoragePath;
+  int replayResidentSize = 0;
+  ObservationFormat replayObservationFormat = ObservationFormat::Float32;
+  ActionFormat replayActionFormat = ActionFormat::Float32;
+  bool prioritizedReplay = false;
+  float priorityAlpha = 0.6;
+  float priorityBeta = 0.4;
+  float priorityEpsilon = 1e-6;
   float learningRate = 3e-4;
   float interpolation = 0.995;
   IntArray hiddenLayerSizes = {64, 64};
+  int criticCount = 2;
+  int environmentCount = 1;
+  int workerCount = 0;
+  bool asyncLearner = false;
+  float updateToDataRatio = 1;
+  int publishInterval = 50;
+  PhysicsConfig physics;
 };
 
 #endif // CONFIG_H
@@ -0,0 +1,179 @@
+
+#include "DenseKernel.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define DENSE_KERNEL_AVX2
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*BlockFunction)(const float *input, int inputLength,
+                              const float *weights, int stride, const float *biases,
+                              float *output, bool activation);
+
+static const int blockCountMax = 8;
+
+#if defined(__ARM_NEON)
+typedef float32x4_t Lanes;
+static const int laneCount = 4;
+
+static inline Lanes loadLanes(const float *data) { return vld1q_f32(data); }
+static inline Lanes broadcastLanes(float value) { return vdupq_n_f32(value); }
+#if defined(__aarch64__)
+static inline Lanes fmaLanes(Lanes a, Lanes b, Lanes c) { return vfmaq_f32(c, a, b); }
+#else
+static inline Lanes fmaLanes(Lanes a, Lanes b, Lanes c) { return vmlaq_f32(c, a, b); }
+#endif
+static inline Lanes maxLanes(Lanes a, Lanes b) { return vmaxq_f32(a, b); }
+static inline void storeLanes(float *data, Lanes value) { vst1q_f32(data, value); }
+#else
+struct Lanes {
+  float values[4];
+};
+static const int laneCount = 4;
+
+static inline Lanes loadLanes(const float *data) {
+  return {{data[0], data[1], data[2], data[3]}};
+}
+static inline Lanes broadcastLanes(float value) {
+  return {{value, value, value, value}};
+}
+static inline Lanes fmaLanes(Lanes a, Lanes b, Lanes c) {
+  for (int i = 0; i < laneCount; i++) {
+    c.values[i] += a.values[i] * b.values[i];
+  }
+  return c;
+}
+static inline Lanes maxLanes(Lanes a, Lanes b) {
+  for (int i = 0; i < laneCount; i++) {
+    a.values[i] = (a.values[i] > b.values[i] ? a.values[i] : b.values[i]);
+  }
+  return a;
+}
+static inline void storeLanes(float *data, Lanes value) {
+  for (int i = 0; i < laneCount; i++) {
+    data[i] = value.values[i];
+  }
+}
+#endif
+
+// Computes Blocks * laneCount outputs of a dense layer, keeping the
+// accumulators in registers while streaming the pre-transposed weights.
+template<int Blocks>
+static void denseBlock(const float *input, int inputLength,
+                       const float *weights, int stride, const float *biases,
+                       float *output, bool activation) {
+  Lanes accumulators[Blocks];
+  for (int b = 0; b < Blocks; b++) {
+    accumulators[b] = loadLanes(biases + b * laneCount);
+  }
+  for (int i = 0; i < inputLength; i++) {
+    const auto value = broadcastLanes(input[i]);
+    const auto *row = weights + i * stride;
+    for (int b = 0; b < Blocks; b++) {
+      accumulators[b] = fmaLanes(value, loadLanes(row + b * laneCount), accumulators[b]);
+    }
+  }
+  if (activation) {
+    const auto zero = broadcastLanes(0);
+    for (int b = 0; b < Blocks; b++) {
+      accumulators[b] = maxLanes(accumulators[b], zero);
+    }
+  }
+  for (int b = 0; b < Blocks; b++) {
+    storeLanes(output + b * laneCount, accumulators[b]);
+  }
+}
+
+static const BlockFunction blockFunctions[blockCountMax + 1] = {
+  nullptr, denseBlock<1>, denseBlock<2>, denseBlock<3>, denseBlock<4>,
+  denseBlock<5>, denseBlock<6>, denseBlock<7>, denseBlock<8>
+};
+
+#ifdef DENSE_KERNEL_AVX2
+static const int avx2LaneCount = 8;
+
+template<int Blocks>
+AVX2_TARGET static void denseBlockAvx2(const float *input, int inputLength,
+                                       const float *weights, int stride, const float *biases,
+                                       float *output, bool activation) {
+  __m256 accumulators[Blocks];
+  for (int b = 0; b < Blocks; b++) {
+    accumulators[b] = _mm256_loadu_ps(biases + b * avx2LaneCount);
+  }
+  for (int i = 0; i < inputLength; i++) {
+    const auto value = _mm256_set1_ps(input[i]);
+    const auto *row = weights + i * stride;
+    for (int b = 0; b < Blocks; b++) {
+      accumulators[b] = _mm256_fmadd_ps(value, _mm256_loadu_ps(row + b * avx2LaneCount),
+                                        accumulators[b]);
+    }
+  }
+  if (activation) {
+    const auto zero = _mm256_setzero_ps();
+    for (int b = 0; b < Blocks; b++) {
+      accumulators[b] = _mm256_max_ps(accumulators[b], zero);
+    }
+  }
+  for (int b = 0; b < Blocks; b++) {
+    _mm256_storeu_ps(output + b * avx2LaneCount, accumulators[b]);
+  }
+}
+
+static const BlockFunction avx2BlockFunctions[blockCountMax + 1] = {
+  nullptr, denseBlockAvx2<1>, denseBlockAvx2<2>, denseBlockAvx2<3>, denseBlockAvx2<4>,
+  denseBlockAvx2<5>, denseBlockAvx2<6>, denseBlockAvx2<7>, denseBlockAvx2<8>
+};
+
+static bool avx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static const bool useAvx2 = avx2Supported();
+
+static_assert(DenseKernel::outputPadding % avx2LaneCount == 0, "Padding must cover whole lanes");
+#else
+static const bool useAvx2 = false;
+#endif
+
+static_assert(DenseKernel::outputPadding % laneCount == 0, "Padding must cover whole lanes");
+
+float* DenseKernel::forward(const Layer *layers, int layerCount, float *input, float *output) {
+  const auto *functions = blockFunctions;
+  auto lanes = laneCount;
+#ifdef DENSE_KERNEL_AVX2
+  if (useAvx2) {
+    functions = avx2BlockFunctions;
+    lanes = avx2LaneCount;
+  }
+#endif
+  for (int l = 0; l < layerCount; l++) {
+    const auto &layer = layers[l];
+    const auto blocks = layer.paddedOutputLength / lanes;
+    for (int b = 0; b < blocks; b += blockCountMax) {
+      const auto count = (blocks - b < blockCountMax ? blocks - b : blockCountMax);
+      const auto offset = b * lanes;
+      functions[count](input, layer.inputLength, layer.weights + offset, layer.paddedOutputLength,
+                       layer.biases + offset, output + offset, layer.activation);
+    }
+    auto *swap = input;
+    input = output;
+    output = swap;
+  }
+  return input;
+}
+
+const char* DenseKernel::instructionSet() {
+  if (useAvx2) {
+    return "avx2";
+  }
+#if defined(__ARM_NEON)
+  return "neon";
+#else
+  return "generic";
+#endif
+}
@@ -0,0 +1,25 @@
+
+#ifndef DENSEKERNEL_H
+#define DENSEKERNEL_H
+
+// Kept free of torch and shared headers, so that its translation unit may be
+// compiled for another instruction set without breaking inline functions.
+class DenseKernel {
+public:
+  struct Layer {
+    int inputLength;
+    int paddedOutputLength;
+    bool activation;
+    const float *weights; // inputLength rows of paddedOutputLength values
+    const float *biases;
+  };
+
+  static const int outputPadding = 8;
+
+  // Returns the buffer that holds the outputs of the last layer.
+  static float* forward(const Layer *layers, int layerCount, float *input, float *output);
+
+  static const char* instructionSet();
+};
+
+#endif // DENSEKERNEL_H
@@ -1,5 +1,6 @@
 
 #include "Environment.h"
+#include "Profiler.h"
 
 void Environment::init(int observationLength, int actionLength, int moveCountMax) {
   this->observation = Observation(0.0, observationLength);
@@ -9,6 +10,7 @@ void Environment::init(int observationLength, int actionLength, int moveCountMax
 }
 
 void Environment::restart() {
+  PROFILE_SCOPE("Environment::restart");
   reset();
 
   update();
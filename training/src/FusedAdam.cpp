@@ -0,0 +1,47 @@
+
+#include "FusedAdam.h"
+#include "ParameterKernel.h"
+#include "BinaryStream.h"
+
+#include <cmath>
+
+FusedAdam::FusedAdam(ParameterArena &arena, float learningRate,
+                     float beta1, float beta2, float epsilon)
+    : arena(arena)
+    , learningRate(learningRate)
+    , beta1(beta1)
+    , beta2(beta2)
+    , epsilon(epsilon)
+    , stepCount(0) {
+}
+
+void FusedAdam::step() {
+  stepCount++;
+  const auto biasCorrection1 = 1 - std::pow(beta1, static_cast<double>(stepCount));
+  const auto biasCorrection2 = 1 - std::pow(beta2, static_cast<double>(stepCount));
+  ParameterKernel::AdamStep adamStep;
+  adamStep.beta1 = beta1;
+  adamStep.beta2 = beta2;
+  adamStep.stepSize = static_cast<float>(learningRate / biasCorrection1);
+  adamStep.inverseBiasCorrection2 = static_cast<float>(1 / std::sqrt(biasCorrection2));
+  adamStep.epsilon = epsilon;
+  ParameterKernel::adam(adamStep, arena.size(), arena.grad.data_ptr<float>(),
+                        arena.firstMoment.data_ptr<float>(), arena.secondMoment.data_ptr<float>(),
+                        arena.data.data_ptr<float>());
+}
+
+void FusedAdam::save(std::ostream &stream) const {
+  writeBinary<int64_t>(stream, stepCount);
+  writeBinary<int64_t>(stream, arena.size());
+  writeBinary(stream, arena.firstMoment.data_ptr<float>(), arena.size());
+  writeBinary(stream, arena.secondMoment.data_ptr<float>(), arena.size());
+}
+
+void FusedAdam::load(std::istream &stream) {
+  stepCount = readBinary<int64_t>(stream);
+  if (readBinary<int64_t>(stream) != arena.size()) {
+    EXCEPT("Optimizer state does not match parameters");
+  }
+  readBinary(stream, arena.firstMoment.data_ptr<float>(), arena.size());
+  readBinary(stream, arena.secondMoment.data_ptr<float>(), arena.size());
+}
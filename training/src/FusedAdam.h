@@ -0,0 +1,25 @@
+
+#ifndef FUSEDADAM_H
+#define FUSEDADAM_H
+
+#include "ParameterArena.h"
+
+class FusedAdam {
+public:
+  FusedAdam(ParameterArena &arena, float learningRate,
+            float beta1 = 0.9, float beta2 = 0.999, float epsilon = 1e-8);
+
+  void step();
+
+  void save(std::ostream &stream) const;
+  void load(std::istream &stream);
+
+  ParameterArena &arena;
+  float learningRate;
+  float beta1;
+  float beta2;
+  float epsilon;
+  int64_t stepCount;
+};
+
+#endif // FUSEDADAM_H
@@ -0,0 +1,85 @@
+
+#include "Learner.h"
+#include "Network.h"
+#include "ReplayBuffer.h"
+#include "ActorSnapshot.h"
+#include "TransitionQueue.h"
+
+static const int drainCountMax = 1024;
+
+Learner::Learner(const Config &config, NetworkPtr network, ReplayBufferPtr replayBuffer,
+                 TransitionQueuePtr queue, ActorSnapshotPtr snapshot, int trainingStartSteps,
+                 int transitionCount, int trainCount)
+    : config(config)
+    , network(network)
+    , replayBuffer(replayBuffer)
+    , queue(queue)
+    , snapshot(snapshot)
+    , trainingStartSteps(trainingStartSteps)
+    , transitionCount(transitionCount)
+    , trainCount(trainCount)
+    , running(true) {
+  thread = std::thread(&Learner::run, this);
+}
+
+Learner::~Learner() {
+  running = false;
+  thread.join();
+}
+
+void Learner::run() {
+  while (running) {
+    int count = 0;
+    {
+      std::lock_guard<std::mutex> lock(networkMutex);
+      count = queue->drain(*replayBuffer, drainCountMax);
+    }
+    transitionCount += count;
+
+    if (!trainable()) {
+      if (count == 0) {
+        std::this_thread::yield();
+      }
+      continue;
+    }
+
+    const auto startTrainTime = std::chrono::steady_clock::now();
+    ActorCriticLosses losses;
+    {
+      std::lock_guard<std::mutex> lock(networkMutex);
+      auto &batch = replayBuffer->sampleBatch();
+      losses = network->train(batch);
+      replayBuffer->updatePriorities(batch);
+      trainCount++;
+      if ((trainCount % config.publishInterval) == 0) {
+        snapshot->publish(*network->model->actor);
+      }
+    }
+    const auto trainTime = std::chrono::duration_cast<std::chrono::microseconds>
+                           (std::chrono::steady_clock::now() - startTrainTime).count();
+
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    statistics.stepCount++;
+    statistics.losses.first += losses.first;
+    statistics.losses.second += losses.second;
+    statistics.time += trainTime;
+  }
+}
+
+bool Learner::trainable() const {
+  const auto transitions = transitionCount.load();
+  if ((transitions <= trainingStartSteps) || replayBuffer->empty()) {
+    return false;
+  }
+  if (config.updateToDataRatio <= 0) {
+    return true;
+  }
+  return (trainCount < (transitions - trainingStartSteps) * config.updateToDataRatio);
+}
+
+TrainStatistics Learner::collectStatistics() {
+  std::lock_guard<std::mutex> lock(statisticsMutex);
+  const auto collectedStatistics = statistics;
+  statistics = {};
+  return collectedStatistics;
+}
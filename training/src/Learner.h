@@ -0,0 +1,39 @@
+
+#ifndef LEARNER_H
+#define LEARNER_H
+
+#include "Config.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+class Learner {
+public:
+  Learner(const Config &config, NetworkPtr network, ReplayBufferPtr replayBuffer,
+          TransitionQueuePtr queue, ActorSnapshotPtr snapshot, int trainingStartSteps,
+          int transitionCount = 0, int trainCount = 0);
+  Learner(const Learner &learner) = delete;
+  ~Learner();
+
+  void run();
+  bool trainable() const;
+
+  TrainStatistics collectStatistics();
+
+  Config config;
+  NetworkPtr network;
+  ReplayBufferPtr replayBuffer;
+  TransitionQueuePtr queue;
+  ActorSnapshotPtr snapshot;
+  int trainingStartSteps;
+  std::atomic<int> transitionCount;
+  int trainCount;
+  TrainStatistics statistics;
+  std::mutex statisticsMutex;
+  std::mutex networkMutex;
+  std::atomic<bool> running;
+  std::thread thread;
+};
+
+#endif // LEARNER_H
@@ -0,0 +1,62 @@
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const String &filePath)
+    : mapping(nullptr)
+    , length(0) {
+#ifdef _WIN32
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file) {
+    EXCEPT("Failed to open " + filePath);
+  }
+  buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  mapping = buffer.data();
+  length = buffer.size();
+#else
+  const auto descriptor = ::open(filePath.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    EXCEPT("Failed to open " + filePath);
+  }
+  struct stat status;
+  if (::fstat(descriptor, &status) != 0) {
+    ::close(descriptor);
+    EXCEPT("Failed to stat " + filePath);
+  }
+  length = status.st_size;
+  if (length > 0) {
+    auto *address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (address == MAP_FAILED) {
+      ::close(descriptor);
+      EXCEPT("Failed to map " + filePath);
+    }
+    mapping = static_cast<const char*>(address);
+  }
+  ::close(descriptor);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (mapping != nullptr) {
+    ::munmap(const_cast<char*>(mapping), length);
+  }
+#endif
+}
+
+const char* MappedFile::data() const {
+  return mapping;
+}
+
+size_t MappedFile::size() const {
+  return length;
+}
@@ -0,0 +1,22 @@
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "Types.h"
+
+class MappedFile {
+public:
+  MappedFile(const String &filePath);
+  MappedFile(const MappedFile &mappedFile) = delete;
+  ~MappedFile();
+
+  const char* data() const;
+  size_t size() const;
+
+private:
+  const char *mapping;
+  size_t length;
+  String buffer;
+};
+
+#endif // MAPPEDFILE_H
@@ -39,28 +39,72 @@ torch::Tensor Actor::forward(torch::Tensor observation) {
   return sample;
 }
 
-Critic::Critic(const IntArray &hiddenLayerSizes, int observationLength, int actionLength)
+Critic::Critic(const IntArray &hiddenLayerSizes, int observationLength, int actionLength,
+               int ensembleSize)
     : hiddenLayerSizes(hiddenLayerSizes)
     , observationLength(observationLength)
-    , actionLength(actionLength) {
+    , actionLength(actionLength)
+    , ensembleSize(ensembleSize) {
   reset();
 }
 
 void Critic::reset() {
-  q1 = register_module("q1", mlpNet(hiddenLayerSizes, observationLength + actionLength, 1));
-  q2 = register_module("q2", mlpNet(hiddenLayerSizes, observationLength + actionLength, 1));
+  if (hiddenLayerSizes.empty()) {
+    throw std::runtime_error("Hidden layer sizes must be given");
+  }
+  if (ensembleSize < 1) {
+    throw std::runtime_error("Critic ensemble size must be positive");
+  }
+
+  // The first layer is split into observation and action parts laid out as
+  // [input, ensemble, output], so that all heads share a single matmul per part.
+  const auto inputLength = observationLength + actionLength;
+  const auto inputBound = 1 / std::sqrt(static_cast<float>(inputLength));
+  const auto firstLength = hiddenLayerSizes.front();
+  observationWeight = register_parameter("observationWeight",
+    torch::empty({observationLength, ensembleSize, firstLength}).uniform_(-inputBound, inputBound));
+  actionWeight = register_parameter("actionWeight",
+    torch::empty({actionLength, ensembleSize, firstLength}).uniform_(-inputBound, inputBound));
+  inputBias = register_parameter("inputBias",
+    torch::empty({ensembleSize, firstLength}).uniform_(-inputBound, inputBound));
+
+  weights.clear();
+  biases.clear();
+  for (int i = 0; i < static_cast<int>(hiddenLayerSizes.size()); i++) {
+    const auto layerInputLength = hiddenLayerSizes[i];
+    const auto layerOutputLength = (i + 1 < static_cast<int>(hiddenLayerSizes.size())
+                                    ? hiddenLayerSizes[i + 1] : 1);
+    const auto bound = 1 / std::sqrt(static_cast<float>(layerInputLength));
+    weights.push_back(register_parameter("weight" + std::to_string(i),
+      torch::empty({ensembleSize, layerInputLength, layerOutputLength}).uniform_(-bound, bound)));
+    biases.push_back(register_parameter("bias" + std::to_string(i),
+      torch::empty({ensembleSize, 1, layerOutputLength}).uniform_(-bound, bound)));
+  }
 }
 
-std::pair<torch::Tensor, torch::Tensor>
-Critic::forward(torch::Tensor observation, torch::Tensor action) {
-  const auto observationAction = torch::cat({observation, action}, 1);
-  return {q1->forward(observationAction), q2->forward(observationAction)};
+torch::Tensor Critic::forward(torch::Tensor observation, torch::Tensor action) {
+  const auto batchSize = observation.size(0);
+  const auto firstLength = hiddenLayerSizes.front();
+  auto hidden = torch::addmm(inputBias.view({ensembleSize * firstLength}), observation,
+                             observationWeight.view({observationLength, ensembleSize * firstLength}));
+  hidden = torch::addmm(hidden, action,
+                        actionWeight.view({actionLength, ensembleSize * firstLength}));
+  hidden = torch::relu(hidden.view({batchSize, ensembleSize, firstLength}).transpose(0, 1));
+  for (size_t i = 0; i < weights.size(); i++) {
+    hidden = torch::baddbmm(biases[i], hidden, weights[i]);
+    if (i + 1 < weights.size()) {
+      hidden = torch::relu(hidden);
+    }
+  }
+  return hidden;
 }
 
-Model::Model(const IntArray &hiddenLayerSizes, int observationLength, int actionLength)
+Model::Model(const IntArray &hiddenLayerSizes, int observationLength, int actionLength,
+             int criticCount)
     : hiddenLayerSizes(hiddenLayerSizes)
     , observationLength(observationLength)
-    , actionLength(actionLength) {
+    , actionLength(actionLength)
+    , criticCount(criticCount) {
   reset();
 }
 
@@ -68,5 +112,5 @@ void Model::reset() {
   actor = register_module("actor", std::make_shared<Actor>(
     hiddenLayerSizes, observationLength, actionLength));
   critic = register_module("critic", std::make_shared<Critic>(
-    hiddenLayerSizes, observationLength, actionLength));
+    hiddenLayerSizes, observationLength, actionLength, criticCount));
 }
@@ -27,30 +27,36 @@ public:
 
 class Critic : public torch::nn::Cloneable<Critic> {
 public:
-  Critic(const IntArray &hiddenLayerSizes, int observationLength, int actionLength);
+  Critic(const IntArray &hiddenLayerSizes, int observationLength, int actionLength,
+         int ensembleSize);
 
   void reset() override;
 
-  std::pair<torch::Tensor, torch::Tensor>
-  forward(torch::Tensor observation, torch::Tensor action);
+  torch::Tensor forward(torch::Tensor observation, torch::Tensor action);
 
   IntArray hiddenLayerSizes;
   int observationLength;
   int actionLength;
+  int ensembleSize;
 
-  torch::nn::Sequential q1 = nullptr;
-  torch::nn::Sequential q2 = nullptr;
+  torch::Tensor observationWeight;
+  torch::Tensor actionWeight;
+  torch::Tensor inputBias;
+  Array<torch::Tensor> weights;
+  Array<torch::Tensor> biases;
 };
 
 class Model : public torch::nn::Cloneable<Model> {
 public:
-  Model(const IntArray &hiddenLayerSizes, int observationLength, int actionLength);
+  Model(const IntArray &hiddenLayerSizes, int observationLength, int actionLength,
+        int criticCount);
 
   void reset() override;
 
   IntArray hiddenLayerSizes;
   int observationLength;
   int actionLength;
+  int criticCount;
 
   ActorPtr actor;
   CriticPtr critic;
@@ -1,9 +1,64 @@
 
 #include "Network.h"
+#include "ReplayBuffer.h"
 #include "Base64.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+static const std::array<char, 4> checkpointMagic = {'T', 'W', 'N', '1'};
+
+static void checkLegacyShape(const torch::Tensor &tensor, const std::vector<int64_t> &shape) {
+  if (tensor.sizes() != torch::IntArrayRef(shape)) {
+    EXCEPT("Legacy critic does not match network");
+  }
+}
+
+// Checkpoints written before the stacked critic hold q1 and q2 as Linear/ReLU
+// sequences, with their linear layers at even indices.
+static void loadLegacyCritic(torch::serialize::InputArchive &archive, Critic &critic) {
+  const std::array<const char*, 2> names = {"q1", "q2"};
+  if (critic.ensembleSize != static_cast<int>(names.size())) {
+    EXCEPT("Legacy checkpoint holds 2 critics, network has " + std::to_string(critic.ensembleSize));
+  }
+  const auto observationLength = critic.observationLength;
+  const auto actionLength = critic.actionLength;
+  for (int k = 0; k < static_cast<int>(names.size()); k++) {
+    torch::serialize::InputArchive netArchive;
+    if (!archive.try_read(names[k], netArchive)) {
+      EXCEPT(String("Legacy checkpoint has no critic ") + names[k]);
+    }
+    for (size_t i = 0; i <= critic.weights.size(); i++) {
+      torch::serialize::InputArchive linearArchive;
+      torch::Tensor weight;
+      torch::Tensor bias;
+      if (!netArchive.try_read(std::to_string(2 * i), linearArchive) ||
+          !linearArchive.try_read("weight", weight) || !linearArchive.try_read("bias", bias)) {
+        EXCEPT(String("Legacy critic ") + names[k] + " has no layer " + std::to_string(i));
+      }
+      if (i == 0) {
+        const auto outputLength = critic.inputBias.size(1);
+        checkLegacyShape(weight, {outputLength, observationLength + actionLength});
+        checkLegacyShape(bias, {outputLength});
+        critic.observationWeight.select(1, k).copy_(weight.narrow(1, 0, observationLength).t());
+        critic.actionWeight.select(1, k).copy_(weight.narrow(1, observationLength, actionLength).t());
+        critic.inputBias[k].copy_(bias);
+      } else {
+        const auto &stackedWeight = critic.weights[i - 1];
+        checkLegacyShape(weight, {stackedWeight.size(2), stackedWeight.size(1)});
+        checkLegacyShape(bias, {stackedWeight.size(2)});
+        stackedWeight[k].copy_(weight.t());
+        critic.biases[i - 1][k][0].copy_(bias);
+      }
+    }
+  }
+}
 
 Network::Network(const Config &config, int observationLength, int actionLength)
-    : Network(config, std::make_shared<Model>(config.hiddenLayerSizes, observationLength, actionLength)) {
+    : Network(config, std::make_shared<Model>(config.hiddenLayerSizes, observationLength, actionLength,
+                                              config.criticCount)) {
 }
 
 Network::Network(const Config &config, ModelPtr model)
@@ -14,19 +69,25 @@ Network::Network(const Config &config, ModelPtr model, CriticPtr targetCritic)
     : config(config)
     , model(model)
     , targetCritic(targetCritic)
-    , actorOptimizer(new torch::optim::Adam(model->actor->parameters(),
-                     torch::optim::AdamOptions(config.learningRate)))
-    , criticOptimizer(new torch::optim::Adam(model->critic->parameters(),
-                      torch::optim::AdamOptions(config.learningRate))) {
+    , actorParameters(*model->actor)
+    , criticParameters(*model->critic)
+    , targetCriticParameters(*targetCritic)
+    , actorOptimizer(actorParameters, config.learningRate)
+    , criticOptimizer(criticParameters, config.learningRate)
+    , actorVersion(0)
+    , packedActorVersion(-1) {
   for (auto &parameter : targetCritic->parameters()) {
     parameter.set_requires_grad(false);
   }
 }
 
 NetworkPtr Network::clone() const {
-  return std::make_shared<Network>(config,
-    std::dynamic_pointer_cast<Model>(model->clone()),
-    std::dynamic_pointer_cast<Critic>(targetCritic->clone()));
+  torch::NoGradGuard noGradGuard;
+  auto network = std::make_shared<Network>(config, model->observationLength, model->actionLength);
+  network->actorParameters.data.copy_(actorParameters.data);
+  network->criticParameters.data.copy_(criticParameters.data);
+  network->targetCriticParameters.data.copy_(targetCriticParameters.data);
+  return network;
 }
 
 String Network::save() const {
@@ -36,7 +97,15 @@ String Network::save() const {
 }
 
 void Network::save(std::ostream &stream) const {
-  torch::save(model, stream);
+  const int64_t actorSize = actorParameters.size();
+  const int64_t criticSize = criticParameters.size();
+  stream.write(checkpointMagic.data(), checkpointMagic.size());
+  stream.write(reinterpret_cast<const char*>(&actorSize), sizeof(actorSize));
+  stream.write(reinterpret_cast<const char*>(&criticSize), sizeof(criticSize));
+  stream.write(reinterpret_cast<const char*>(actorParameters.data.data_ptr<float>()),
+               actorSize * sizeof(float));
+  stream.write(reinterpret_cast<const char*>(criticParameters.data.data_ptr<float>()),
+               criticSize * sizeof(float));
 }
 
 void Network::load(const String &data) {
@@ -45,102 +114,161 @@ void Network::load(const String &data) {
   if (!error.empty()) {
     EXCEPT(error);
   }
-  std::istringstream stream(out);
-  load(stream);
+  load(out.data(), out.size());
 }
 
 void Network::load(std::istream &stream) {
-  torch::load(model, stream);
+  const String data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  load(data.data(), data.size());
 }
 
-Action Network::predict(const Observation &observation) {
-  torch::NoGradGuard noGradGuard;
+void Network::load(const char *data, size_t size) {
+  int64_t actorSize = 0;
+  int64_t criticSize = 0;
+  const auto headerSize = checkpointMagic.size() + sizeof(actorSize) + sizeof(criticSize);
+  if ((size < headerSize) || !std::equal(checkpointMagic.begin(), checkpointMagic.end(), data)) {
+    torch::serialize::InputArchive archive;
+    archive.load_from(data, size);
+    torch::serialize::InputArchive actorArchive;
+    if (!archive.try_read("actor", actorArchive)) {
+      EXCEPT("Checkpoint has no actor");
+    }
+    model->actor->load(actorArchive);
+    actorParameters.bind();
+    torch::serialize::InputArchive criticArchive;
+    if (archive.try_read("critic", criticArchive)) {
+      torch::NoGradGuard noGradGuard;
+      loadLegacyCritic(criticArchive, *model->critic);
+    }
+    actorVersion++;
+    return;
+  }
+
+  std::memcpy(&actorSize, data + checkpointMagic.size(), sizeof(actorSize));
+  std::memcpy(&criticSize, data + checkpointMagic.size() + sizeof(actorSize), sizeof(criticSize));
+  if ((actorSize != actorParameters.size()) || (criticSize != criticParameters.size())) {
+    EXCEPT("Checkpoint does not match network");
+  }
+  if (size < headerSize + (actorSize + criticSize) * sizeof(float)) {
+    EXCEPT("Checkpoint is truncated");
+  }
+  std::memcpy(actorParameters.data.data_ptr<float>(), data + headerSize,
+              actorSize * sizeof(float));
+  std::memcpy(criticParameters.data.data_ptr<float>(), data + headerSize + actorSize * sizeof(float),
+              criticSize * sizeof(float));
+  actorVersion++;
+}
 
-  const auto inputObservation = torch::from_blob(
-    reinterpret_cast<void*>(const_cast<float*>(&observation[0])),
-    {1, static_cast<int>(observation.size())}, torch::kFloat32);
+void Network::saveState(std::ostream &stream) const {
+  actorParameters.save(stream);
+  criticParameters.save(stream);
+  targetCriticParameters.save(stream);
+  actorOptimizer.save(stream);
+  criticOptimizer.save(stream);
+}
 
-  const auto sample = model->actor->forward(inputObservation);
-  const auto sampleAccessor = sample.accessor<float, 2>();
-  Action action(0.0, model->actionLength);
-  for (int i = 0; i < model->actionLength; i++) {
-    action[i] = sampleAccessor[0][i];
+void Network::loadState(std::istream &stream) {
+  torch::NoGradGuard noGradGuard;
+  actorParameters.load(stream);
+  criticParameters.load(stream);
+  targetCriticParameters.load(stream);
+  actorOptimizer.load(stream);
+  criticOptimizer.load(stream);
+  actorVersion++;
+}
+
+void Network::packActor() {
+  if (packedActorVersion != actorVersion) {
+    actorKernel.pack(*model->actor);
+    packedActorVersion = actorVersion;
   }
+}
+
+Action Network::predict(const Observation &observation) {
+  PROFILE_SCOPE("Network::predict");
+  packActor();
 
+  Action action(0.0, model->actionLength);
+  actorKernel.forward(&observation[0], &action[0]);
   return action;
 }
 
-ActorCriticLosses Network::train(const SamplePtrs &samples) {
-  if (samples.empty()) {
-    return {0, 0};
-  }
-
-  const auto batchSize = static_cast<int>(samples.size());
-  std::vector<torch::Tensor> observations;
-  std::vector<torch::Tensor> nextObservations;
-  std::vector<torch::Tensor> actions;
-  const auto reward = torch::empty({batchSize, 1}, torch::kFloat32);
-  const auto undone = torch::empty({batchSize, 1}, torch::kFloat32);
-  for (int i = 0; i < batchSize; i++) {
-    const auto &[observation, action, r, nextObservation, d] = *samples[i];
-    observations.push_back(
-      torch::from_blob(reinterpret_cast<void*>(const_cast<float*>(&observation[0])),
-      {1, static_cast<int>(observation.size())}, torch::kFloat32));
-    nextObservations.push_back(
-      torch::from_blob(reinterpret_cast<void*>(const_cast<float*>(&nextObservation[0])),
-      {1, static_cast<int>(nextObservation.size())}, torch::kFloat32));
-    actions.push_back(
-      torch::from_blob(reinterpret_cast<void*>(const_cast<float*>(&action[0])),
-      {1, static_cast<int>(action.size())}, torch::kFloat32));
-    reward[i][0] = r;
-    undone[i][0] = (d ? 0 : 1);
-  }
-  const auto observation = torch::cat(observations);
-  const auto nextObservation = torch::cat(nextObservations);
-  const auto action = torch::cat(actions);
-
-  criticOptimizer->zero_grad();
-  const auto [q1, q2] = model->critic->forward(observation, action);
-  torch::Tensor backup;
+// The packed kernel only serves single observations, batches take one batched forward pass.
+torch::Tensor Network::predict(const torch::Tensor &observation) {
+  PROFILE_SCOPE("Network::predict");
+  torch::NoGradGuard noGradGuard;
+  return model->actor->forward(observation);
+}
+
+ActorCriticLosses Network::train(Batch &batch) {
+  const auto &observation = batch.observation;
+  const auto &action = batch.action;
+  const auto &reward = batch.reward;
+  const auto &nextObservation = batch.nextObservation;
+  const auto &done = batch.done;
+
+  torch::Tensor criticLoss;
+  {
+    PROFILE_SCOPE("Network::criticForward");
+    criticParameters.zeroGrad();
+    const auto q = model->critic->forward(observation, action);
+    torch::Tensor backup;
+    {
+      PROFILE_SCOPE("Network::targetForward");
+      torch::NoGradGuard noGradGuard;
+      const auto nextAction = model->actor->forward(nextObservation);
+      const auto targetQ = std::get<0>(targetCritic->forward(nextObservation, nextAction).min(0));
+      backup = reward + config.discount * (1 - done) * targetQ;
+    }
+    const auto error = q - backup;
+    if (batch.weight.defined()) {
+      criticLoss = (batch.weight * error.pow(2)).mean({1, 2}).sum();
+    } else {
+      criticLoss = error.pow(2).mean({1, 2}).sum();
+    }
+    if (batch.tdError.defined()) {
+      torch::NoGradGuard noGradGuard;
+      batch.tdError.copy_(error.abs().mean(0));
+    }
+  }
+  {
+    PROFILE_SCOPE("Network::criticBackward");
+    criticLoss.backward();
+  }
   {
-    torch::NoGradGuard noGradGuard;
-    const auto nextAction = model->actor->forward(nextObservation);
-    const auto [targetQ1, targetQ2] = targetCritic->forward(nextObservation, nextAction);
-    const auto targetQ = torch::min(targetQ1, targetQ2);
-    backup = reward + config.discount * undone * targetQ;
-  }
-  const auto lossQ1 = torch::mse_loss(q1, backup);
-  const auto lossQ2 = torch::mse_loss(q2, backup);
-  const auto criticLoss = lossQ1 + lossQ2;
-  criticLoss.backward();
-  criticOptimizer->step();
+    PROFILE_SCOPE("Network::criticOptimizer");
+    criticOptimizer.step();
+  }
 
   for (auto &parameter : model->critic->parameters()) {
     parameter.set_requires_grad(false);
   }
 
-  actorOptimizer->zero_grad();
-  const auto sample = model->actor->forward(observation);
-  const auto [sampleQ1, sampleQ2] = model->critic->forward(observation, sample);
-  const auto sampleQ = torch::min(sampleQ1, sampleQ2);
-  const auto actorLoss = -sampleQ.mean();
-  actorLoss.backward();
-  actorOptimizer->step();
+  torch::Tensor actorLoss;
+  {
+    PROFILE_SCOPE("Network::actorForward");
+    actorParameters.zeroGrad();
+    const auto sample = model->actor->forward(observation);
+    const auto sampleQ = std::get<0>(model->critic->forward(observation, sample).min(0));
+    actorLoss = -sampleQ.mean();
+  }
+  {
+    PROFILE_SCOPE("Network::actorBackward");
+    actorLoss.backward();
+  }
+  {
+    PROFILE_SCOPE("Network::actorOptimizer");
+    actorOptimizer.step();
+    actorVersion++;
+  }
 
   for (auto &parameter : model->critic->parameters()) {
     parameter.set_requires_grad(true);
   }
 
   {
-    torch::NoGradGuard noGradGuard;
-    const auto onlineCriticParameters = model->critic->parameters();
-    const auto targetCriticParameters = targetCritic->parameters();
-    for (size_t i = 0; i < onlineCriticParameters.size(); i++) {
-      const auto &onlineCriticParameter = onlineCriticParameters[i];
-      auto &targetCriticParameter = targetCriticParameters[i];
-      targetCriticParameter.mul_(config.interpolation);
-      targetCriticParameter.add_((1 - config.interpolation) * onlineCriticParameter);
-    }
+    PROFILE_SCOPE("Network::targetUpdate");
+    targetCriticParameters.interpolate(criticParameters, config.interpolation);
   }
 
   return {actorLoss.item<float>(), criticLoss.item<float>()};
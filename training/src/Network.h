@@ -5,11 +5,12 @@
 #include "Types.h"
 #include "Config.h"
 #include "Model.h"
+#include "ActorKernel.h"
+#include "ParameterArena.h"
+#include "FusedAdam.h"
 
 class Network {
 public:
-  typedef std::shared_ptr<torch::optim::Optimizer> OptimizerPtr;
-
   Network(const Config &config, int observationLength, int actionLength);
   Network(const Config &config, ModelPtr model);
   Network(const Config &config, ModelPtr model, CriticPtr targetCritic);
@@ -20,15 +21,28 @@ public:
   void save(std::ostream &stream) const;
   void load(const String &data);
   void load(std::istream &stream);
+  void load(const char *data, size_t size);
+
+  void saveState(std::ostream &stream) const;
+  void loadState(std::istream &stream);
+
+  void packActor();
 
   Action predict(const Observation &observation);
-  ActorCriticLosses train(const SamplePtrs &samples);
+  torch::Tensor predict(const torch::Tensor &observation);
+  ActorCriticLosses train(Batch &batch);
 
   Config config;
   ModelPtr model;
   CriticPtr targetCritic;
-  OptimizerPtr actorOptimizer;
-  OptimizerPtr criticOptimizer;
+  ParameterArena actorParameters;
+  ParameterArena criticParameters;
+  ParameterArena targetCriticParameters;
+  FusedAdam actorOptimizer;
+  FusedAdam criticOptimizer;
+  ActorKernel actorKernel;
+  int actorVersion;
+  int packedActorVersion;
 };
 
 #endif // NETWORK_H
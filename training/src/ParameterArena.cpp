@@ -0,0 +1,66 @@
+
+#include "ParameterArena.h"
+#include "ParameterKernel.h"
+#include "BinaryStream.h"
+
+ParameterArena::ParameterArena(torch::nn::Module &module)
+    : module(module) {
+  bind();
+}
+
+void ParameterArena::bind() {
+  torch::NoGradGuard noGradGuard;
+
+  auto parameters = module.parameters();
+  int64_t count = 0;
+  for (const auto &parameter : parameters) {
+    count += parameter.numel();
+  }
+
+  // The optimizer moments sit next to the parameters and gradients, so that an update
+  // streams through a single allocation.
+  if (!storage.defined() || (storage.size(1) != count)) {
+    storage = torch::zeros({RowCount, count}, torch::kFloat32);
+    data = storage[DataRow];
+    grad = storage[GradRow];
+    firstMoment = storage[FirstMomentRow];
+    secondMoment = storage[SecondMomentRow];
+  }
+
+  int64_t offset = 0;
+  for (auto &parameter : parameters) {
+    const auto parameterCount = parameter.numel();
+    auto dataView = data.narrow(0, offset, parameterCount).view(parameter.sizes());
+    if (parameter.data_ptr() != dataView.data_ptr()) {
+      dataView.copy_(parameter);
+      parameter.set_data(dataView);
+    }
+    parameter.mutable_grad() = grad.narrow(0, offset, parameterCount).view(parameter.sizes());
+    offset += parameterCount;
+  }
+}
+
+void ParameterArena::zeroGrad() {
+  grad.zero_();
+}
+
+void ParameterArena::interpolate(const ParameterArena &source, float interpolation) {
+  ParameterKernel::interpolate(interpolation, size(), source.data.data_ptr<float>(),
+                               data.data_ptr<float>());
+}
+
+int64_t ParameterArena::size() const {
+  return data.numel();
+}
+
+void ParameterArena::save(std::ostream &stream) const {
+  writeBinary<int64_t>(stream, size());
+  writeBinary(stream, data.data_ptr<float>(), size());
+}
+
+void ParameterArena::load(std::istream &stream) {
+  if (readBinary<int64_t>(stream) != size()) {
+    EXCEPT("Parameter state does not match network");
+  }
+  readBinary(stream, data.data_ptr<float>(), size());
+}
@@ -0,0 +1,38 @@
+
+#ifndef PARAMETERARENA_H
+#define PARAMETERARENA_H
+
+#include "Model.h"
+
+class ParameterArena {
+public:
+  ParameterArena(torch::nn::Module &module);
+  ParameterArena(const ParameterArena &arena) = delete;
+
+  void bind();
+
+  void zeroGrad();
+  void interpolate(const ParameterArena &source, float interpolation);
+
+  int64_t size() const;
+
+  void save(std::ostream &stream) const;
+  void load(std::istream &stream);
+
+  enum Row {
+    DataRow,
+    GradRow,
+    FirstMomentRow,
+    SecondMomentRow,
+    RowCount
+  };
+
+  torch::nn::Module &module;
+  torch::Tensor storage; // RowCount rows of size() values
+  torch::Tensor data;
+  torch::Tensor grad;
+  torch::Tensor firstMoment;
+  torch::Tensor secondMoment;
+};
+
+#endif // PARAMETERARENA_H
@@ -0,0 +1,128 @@
+
+#include "ParameterKernel.h"
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define PARAMETER_KERNEL_AVX2
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PARAMETER_KERNEL_NEON
+#endif
+
+#ifdef PARAMETER_KERNEL_AVX2
+// Each function updates whole lanes and returns the count, leaving the rest to the scalar loop.
+AVX2_TARGET static int64_t adamAvx2(const ParameterKernel::AdamStep &step, int64_t count,
+                                    const float *gradients, float *firstMoments,
+                                    float *secondMoments, float *parameters) {
+  const auto beta1 = _mm256_set1_ps(step.beta1);
+  const auto beta2 = _mm256_set1_ps(step.beta2);
+  const auto oneMinusBeta1 = _mm256_set1_ps(1 - step.beta1);
+  const auto oneMinusBeta2 = _mm256_set1_ps(1 - step.beta2);
+  const auto stepSize = _mm256_set1_ps(step.stepSize);
+  const auto inverseBiasCorrection2 = _mm256_set1_ps(step.inverseBiasCorrection2);
+  const auto epsilon = _mm256_set1_ps(step.epsilon);
+  int64_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto gradient = _mm256_loadu_ps(gradients + i);
+    const auto m = _mm256_fmadd_ps(beta1, _mm256_loadu_ps(firstMoments + i),
+                                   _mm256_mul_ps(oneMinusBeta1, gradient));
+    const auto v = _mm256_fmadd_ps(beta2, _mm256_loadu_ps(secondMoments + i),
+                                   _mm256_mul_ps(oneMinusBeta2, _mm256_mul_ps(gradient, gradient)));
+    const auto denominator = _mm256_fmadd_ps(_mm256_sqrt_ps(v), inverseBiasCorrection2, epsilon);
+    const auto update = _mm256_div_ps(_mm256_mul_ps(stepSize, m), denominator);
+    _mm256_storeu_ps(firstMoments + i, m);
+    _mm256_storeu_ps(secondMoments + i, v);
+    _mm256_storeu_ps(parameters + i, _mm256_sub_ps(_mm256_loadu_ps(parameters + i), update));
+  }
+  return i;
+}
+
+AVX2_TARGET static int64_t interpolateAvx2(float interpolation, int64_t count,
+                                           const float *source, float *target) {
+  const auto targetWeight = _mm256_set1_ps(interpolation);
+  const auto sourceWeight = _mm256_set1_ps(1 - interpolation);
+  int64_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto blend = _mm256_fmadd_ps(_mm256_loadu_ps(target + i), targetWeight,
+                                       _mm256_mul_ps(sourceWeight, _mm256_loadu_ps(source + i)));
+    _mm256_storeu_ps(target + i, blend);
+  }
+  return i;
+}
+
+static bool avx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static const bool useAvx2 = avx2Supported();
+#else
+static const bool useAvx2 = false;
+#endif
+
+void ParameterKernel::adam(const AdamStep &step, int64_t count, const float *gradients,
+                           float *firstMoments, float *secondMoments, float *parameters) {
+  int64_t i = 0;
+#if defined(PARAMETER_KERNEL_AVX2)
+  if (useAvx2) {
+    i = adamAvx2(step, count, gradients, firstMoments, secondMoments, parameters);
+  }
+#elif defined(PARAMETER_KERNEL_NEON)
+  const auto inverseBiasCorrection2 = vdupq_n_f32(step.inverseBiasCorrection2);
+  const auto epsilon = vdupq_n_f32(step.epsilon);
+  for (; i + 4 <= count; i += 4) {
+    const auto gradient = vld1q_f32(gradients + i);
+    const auto m = vfmaq_n_f32(vmulq_n_f32(gradient, 1 - step.beta1),
+                               vld1q_f32(firstMoments + i), step.beta1);
+    const auto v = vfmaq_n_f32(vmulq_n_f32(vmulq_f32(gradient, gradient), 1 - step.beta2),
+                               vld1q_f32(secondMoments + i), step.beta2);
+    const auto denominator = vfmaq_f32(epsilon, vsqrtq_f32(v), inverseBiasCorrection2);
+    const auto update = vdivq_f32(vmulq_n_f32(m, step.stepSize), denominator);
+    vst1q_f32(firstMoments + i, m);
+    vst1q_f32(secondMoments + i, v);
+    vst1q_f32(parameters + i, vsubq_f32(vld1q_f32(parameters + i), update));
+  }
+#endif
+  for (; i < count; i++) {
+    const auto gradient = gradients[i];
+    const auto m = step.beta1 * firstMoments[i] + (1 - step.beta1) * gradient;
+    const auto v = step.beta2 * secondMoments[i] + (1 - step.beta2) * gradient * gradient;
+    firstMoments[i] = m;
+    secondMoments[i] = v;
+    parameters[i] -= step.stepSize * m /
+                     (std::sqrt(v) * step.inverseBiasCorrection2 + step.epsilon);
+  }
+}
+
+void ParameterKernel::interpolate(float interpolation, int64_t count, const float *source,
+                                  float *target) {
+  int64_t i = 0;
+#if defined(PARAMETER_KERNEL_AVX2)
+  if (useAvx2) {
+    i = interpolateAvx2(interpolation, count, source, target);
+  }
+#elif defined(PARAMETER_KERNEL_NEON)
+  for (; i + 4 <= count; i += 4) {
+    const auto blend = vfmaq_n_f32(vmulq_n_f32(vld1q_f32(source + i), 1 - interpolation),
+                                   vld1q_f32(target + i), interpolation);
+    vst1q_f32(target + i, blend);
+  }
+#endif
+  for (; i < count; i++) {
+    target[i] = target[i] * interpolation + (1 - interpolation) * source[i];
+  }
+}
+
+const char* ParameterKernel::instructionSet() {
+  if (useAvx2) {
+    return "avx2";
+  }
+#if defined(PARAMETER_KERNEL_NEON)
+  return "neon";
+#else
+  return "generic";
+#endif
+}
@@ -0,0 +1,26 @@
+
+#ifndef PARAMETERKERNEL_H
+#define PARAMETERKERNEL_H
+
+#include <cstdint>
+
+// Kept free of torch and shared headers, so that its translation unit may be
+// compiled for another instruction set without breaking inline functions.
+class ParameterKernel {
+public:
+  struct AdamStep {
+    float beta1;
+    float beta2;
+    float stepSize;
+    float inverseBiasCorrection2;
+    float epsilon;
+  };
+
+  static void adam(const AdamStep &step, int64_t count, const float *gradients,
+                   float *firstMoments, float *secondMoments, float *parameters);
+  static void interpolate(float interpolation, int64_t count, const float *source, float *target);
+
+  static const char* instructionSet();
+};
+
+#endif // PARAMETERKERNEL_H
@@ -0,0 +1,135 @@
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <map>
+
+static const auto profilerStartTime = std::chrono::steady_clock::now();
+
+Profiler& Profiler::instance() {
+  static Profiler profiler;
+  return profiler;
+}
+
+Profiler::Profiler()
+    : enabled(false) {
+}
+
+void Profiler::setEnabled(bool enabled) {
+  this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+long long Profiler::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - profilerStartTime).count();
+}
+
+Profiler::ThreadEvents& Profiler::threadEvents() {
+  thread_local ThreadEventsPtr events;
+  if (events == nullptr) {
+    events = std::make_shared<ThreadEvents>();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    events->threadId = static_cast<int>(threads.size());
+    threads.push_back(events);
+  }
+  return *events;
+}
+
+void Profiler::record(const char *name, long long start, long long duration) {
+  auto &events = threadEvents();
+  std::lock_guard<std::mutex> lock(events.mutex);
+  events.events.push_back({name, events.threadId, start, duration});
+}
+
+Array<Profiler::Event> Profiler::drain() {
+  Array<Event> events;
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (auto &thread : threads) {
+    Array<Event> threadEvents;
+    {
+      std::lock_guard<std::mutex> threadLock(thread->mutex);
+      threadEvents.swap(thread->events);
+      thread->events.reserve(threadEvents.size());
+    }
+    events.insert(events.end(), threadEvents.begin(), threadEvents.end());
+  }
+  return events;
+}
+
+static double percentile(const Array<long long> &durations, double fraction) {
+  const auto index = static_cast<size_t>(fraction * (durations.size() - 1) + 0.5);
+  return durations[index] * 1e-3;
+}
+
+Array<Profiler::Phase> Profiler::summarize(const Array<Event> &events) {
+  std::map<String, Array<long long>> phaseDurations;
+  for (const auto &event : events) {
+    phaseDurations[event.name].push_back(event.duration);
+  }
+
+  Array<Phase> phases;
+  for (auto &[name, durations] : phaseDurations) {
+    std::sort(durations.begin(), durations.end());
+    long long totalDuration = 0;
+    for (const auto duration : durations) {
+      totalDuration += duration;
+    }
+    phases.push_back({name, static_cast<int>(durations.size()), totalDuration * 1e-3,
+                      percentile(durations, 0.5), percentile(durations, 0.9),
+                      percentile(durations, 0.99), durations.back() * 1e-3});
+  }
+  std::sort(phases.begin(), phases.end(), [](const Phase &a, const Phase &b) {
+    return a.totalTime > b.totalTime;
+  });
+  return phases;
+}
+
+void Profiler::beginTrace(std::ostream &stream) {
+  stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+}
+
+void Profiler::writeTrace(std::ostream &stream, const Array<Event> &events, bool &first) {
+  const auto precision = stream.precision(3);
+  const auto flags = stream.setf(std::ios::fixed, std::ios::floatfield);
+  for (const auto &event : events) {
+    stream << (first ? "\n" : ",\n")
+           << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.threadId
+           << ",\"ts\":" << event.start * 1e-3 << ",\"dur\":" << event.duration * 1e-3 << "}";
+    first = false;
+  }
+  stream.precision(precision);
+  stream.flags(flags);
+}
+
+void Profiler::endTrace(std::ostream &stream) {
+  stream << "\n]}\n";
+}
+
+Profiler::TraceFile::~TraceFile() {
+  close();
+}
+
+void Profiler::TraceFile::open(const String &filePath) {
+  close();
+  stream.open(filePath);
+  if (!stream.is_open()) {
+    EXCEPT("Unable to open trace file: " + filePath);
+  }
+  first = true;
+  beginTrace(stream);
+}
+
+bool Profiler::TraceFile::isOpen() const {
+  return stream.is_open();
+}
+
+void Profiler::TraceFile::write(const Array<Event> &events) {
+  writeTrace(stream, events, first);
+}
+
+void Profiler::TraceFile::close() {
+  if (stream.is_open()) {
+    endTrace(stream);
+    stream.close();
+  }
+}
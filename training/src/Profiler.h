@@ -0,0 +1,118 @@
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "Types.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+class Profiler {
+public:
+  struct Event {
+    const char *name;
+    int threadId;
+    long long start;
+    long long duration;
+  };
+
+  struct Phase {
+    String name;
+    int count;
+    double totalTime;
+    double medianTime;
+    double p90Time;
+    double p99Time;
+    double maximumTime;
+  };
+
+  class Scope {
+  public:
+    explicit Scope(const char *name);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    const char *name;
+    long long start;
+  };
+
+  // Chrome trace file, completed when closed or destroyed so that it stays
+  // valid however the run ends.
+  class TraceFile {
+  public:
+    TraceFile() = default;
+    ~TraceFile();
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    void open(const String &filePath);
+    bool isOpen() const;
+    void write(const Array<Event> &events);
+    void close();
+
+  private:
+    std::ofstream stream;
+    bool first = true;
+  };
+
+  static Profiler& instance();
+
+  void setEnabled(bool enabled);
+  bool isEnabled() const;
+
+  void record(const char *name, long long start, long long duration);
+  Array<Event> drain();
+
+  static long long now();
+  static Array<Phase> summarize(const Array<Event> &events);
+  static void beginTrace(std::ostream &stream);
+  static void writeTrace(std::ostream &stream, const Array<Event> &events, bool &first);
+  static void endTrace(std::ostream &stream);
+
+private:
+  struct ThreadEvents {
+    std::mutex mutex;
+    int threadId;
+    Array<Event> events;
+  };
+  typedef std::shared_ptr<ThreadEvents> ThreadEventsPtr;
+
+  Profiler();
+
+  ThreadEvents& threadEvents();
+
+  std::atomic<bool> enabled;
+  std::mutex threadsMutex;
+  Array<ThreadEventsPtr> threads;
+};
+
+inline bool Profiler::isEnabled() const {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+inline Profiler::Scope::Scope(const char *name)
+    : name(name)
+    , start(Profiler::instance().isEnabled() ? Profiler::now() : -1) {
+}
+
+inline Profiler::Scope::~Scope() {
+  if (start >= 0) {
+    Profiler::instance().record(name, start, Profiler::now() - start);
+  }
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef TRAINING_PROFILER
+#define PROFILE_SCOPE(name) const Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif // PROFILER_H
@@ -1,34 +1,304 @@
 
 #include "ReplayBuffer.h"
+#include "SumTree.h"
+#include "ReplayStorage.h"
+#include "ReplayCodec.h"
+#include "Profiler.h"
+#include "BinaryStream.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 
-ReplayBuffer::ReplayBuffer(const Config &config)
+ReplayBuffer::ReplayBuffer(const Config &config, int observationLength, int actionLength)
     : config(config)
+    , observationLength(observationLength)
+    , actionLength(actionLength)
+    , capacity(config.replayBufferSize)
     , cursor(0)
+    , tail(0)
+    , size(0)
+    , frameCapacity(static_cast<int64_t>(capacity) + capacity / 8 + frameReserve)
+    , frameCount(0)
+    , lastFrame(-1)
+    , frameStride(ReplayCodec::size(config.replayObservationFormat, observationLength))
+    , frameOffset(0)
+    , nextFrameOffset(frameOffset + sizeof(int64_t))
+    , actionOffset(nextFrameOffset + sizeof(int32_t))
+    , rewardOffset(actionOffset + ReplayCodec::size(config.replayActionFormat, actionLength))
+    , flagsOffset(rewardOffset + sizeof(float))
+    , stride(flagsOffset + sizeof(uint32_t))
+    , storage(std::make_shared<ReplayStorage>(stride, capacity, config.replayStoragePath,
+                                              config.replayResidentSize))
+    , frames(std::make_shared<ReplayStorage>(frameStride, frameCapacity, config.replayStoragePath,
+                                             config.replayResidentSize))
+    , encodedObservation(frameStride)
+    , transitionChunkCount((capacity + chunkLength - 1) / chunkLength)
+    , dirtyChunks(transitionChunkCount + (frameCapacity + chunkLength - 1) / chunkLength, false)
+    , priorityMax(1)
     , randomGenerator(std::chrono::system_clock::now().time_since_epoch().count()) {
-  buffer.reserve(config.replayBufferSize);
+  batch.observation = torch::empty({config.batchSize, observationLength}, torch::kFloat32);
+  batch.action = torch::empty({config.batchSize, actionLength}, torch::kFloat32);
+  batch.reward = torch::empty({config.batchSize, 1}, torch::kFloat32);
+  batch.nextObservation = torch::empty({config.batchSize, observationLength}, torch::kFloat32);
+  batch.done = torch::empty({config.batchSize, 1}, torch::kFloat32);
+  batch.indices.resize(config.batchSize);
+
+  if (config.prioritizedReplay) {
+    priorities = std::make_shared<SumTree>(capacity);
+    batch.weight = torch::empty({config.batchSize, 1}, torch::kFloat32);
+    batch.tdError = torch::empty({config.batchSize, 1}, torch::kFloat32);
+  }
 }
 
-void ReplayBuffer::append(SamplePtr sample) {
-  if (cursor >= buffer.size()) {
-    buffer.push_back(sample);
+// Each stream (one environment slot) continues from the frame of its previous next
+// observation, so consecutive transitions of an episode share a single stored frame.
+// A restart is detected by the encoded observation no longer matching that frame.
+// The frame is also written again when it is older than the frame of the previous transition,
+// so that frames never decrease from the tail to the cursor.
+void ReplayBuffer::append(int stream, const float *observation, const float *action, float reward,
+                          const float *nextObservation, bool done) {
+  if (stream >= static_cast<int>(streamFrames.size())) {
+    streamFrames.resize(stream + 1, -1);
+  }
+  ReplayCodec::encode(config.replayObservationFormat, observation, observationLength,
+                      encodedObservation.data());
+  auto frame = streamFrames[stream];
+  if (!frameAvailable(frame, 1) || (frame < lastFrame) ||
+      (std::memcmp(frames->record(frame % frameCapacity), encodedObservation.data(),
+                   frameStride) != 0)) {
+    frame = writeFrame(encodedObservation.data());
+  }
+  ReplayCodec::encode(config.replayObservationFormat, nextObservation, observationLength,
+                      encodedObservation.data());
+  const auto nextFrame = writeFrame(encodedObservation.data());
+  streamFrames[stream] = nextFrame;
+  lastFrame = frame;
+
+  const int32_t nextFrameDistance = static_cast<int32_t>(nextFrame - frame);
+  const uint32_t flags = (done ? doneFlag : 0);
+  auto *record = storage->record(cursor);
+  std::memcpy(record + frameOffset, &frame, sizeof(int64_t));
+  std::memcpy(record + nextFrameOffset, &nextFrameDistance, sizeof(int32_t));
+  ReplayCodec::encode(config.replayActionFormat, action, actionLength, record + actionOffset);
+  std::memcpy(record + rewardOffset, &reward, sizeof(float));
+  std::memcpy(record + flagsOffset, &flags, sizeof(uint32_t));
+  storage->written(cursor);
+  dirtyChunks[cursor / chunkLength] = true;
+  if (priorities != nullptr) {
+    priorities->set(cursor, priorityMax);
+  }
+
+  cursor = (cursor + 1) % capacity;
+  if (size == capacity) {
+    tail = cursor;
   } else {
-    buffer[cursor] = sample;
+    size++;
+  }
+}
+
+Batch& ReplayBuffer::sampleBatch() {
+  auto *observation = batch.observation.data_ptr<float>();
+  auto *action = batch.action.data_ptr<float>();
+  auto *reward = batch.reward.data_ptr<float>();
+  auto *nextObservation = batch.nextObservation.data_ptr<float>();
+  auto *done = batch.done.data_ptr<float>();
+
+  {
+    PROFILE_SCOPE("ReplayBuffer::sample");
+    std::uniform_int_distribution<int> indexDistribution(0, size - 1);
+    if (priorities != nullptr) {
+      priorities->flush();
+      const auto segment = priorities->total() / config.batchSize;
+      std::uniform_real_distribution<double> valueDistribution(0, 1);
+      for (int i = 0; i < config.batchSize; i++) {
+        const auto value = (i + valueDistribution(randomGenerator)) * segment;
+        batch.indices[i] = priorities->find(value);
+      }
+    } else {
+      for (int i = 0; i < config.batchSize; i++) {
+        batch.indices[i] = (tail + indexDistribution(randomGenerator)) % capacity;
+      }
+    }
+    if (storage->mapped) {
+      for (const auto index : batch.indices) {
+        storage->prefetch(index);
+      }
+    }
+    if (priorities != nullptr) {
+      const auto weightBase = priorities->minimum();
+      auto *weight = batch.weight.data_ptr<float>();
+      for (int i = 0; i < config.batchSize; i++) {
+        weight[i] = std::pow(priorities->get(batch.indices[i]) / weightBase, -config.priorityBeta);
+      }
+    }
+    if (frames->mapped) {
+      for (const auto index : batch.indices) {
+        int64_t frame;
+        int32_t nextFrameDistance;
+        const auto *record = storage->record(index);
+        std::memcpy(&frame, record + frameOffset, sizeof(int64_t));
+        std::memcpy(&nextFrameDistance, record + nextFrameOffset, sizeof(int32_t));
+        frames->prefetch(frame % frameCapacity);
+        frames->prefetch((frame + nextFrameDistance) % frameCapacity);
+      }
+    }
   }
-  cursor = (cursor + 1) % config.replayBufferSize;
+
+  PROFILE_SCOPE("ReplayBuffer::collate");
+  for (int i = 0; i < config.batchSize; i++) {
+    const auto *record = storage->record(batch.indices[i]);
+    int64_t frame;
+    int32_t nextFrameDistance;
+    std::memcpy(&frame, record + frameOffset, sizeof(int64_t));
+    std::memcpy(&nextFrameDistance, record + nextFrameOffset, sizeof(int32_t));
+    ReplayCodec::decode(config.replayObservationFormat, frames->record(frame % frameCapacity),
+                        observationLength, observation + i * observationLength);
+    ReplayCodec::decode(config.replayObservationFormat,
+                        frames->record((frame + nextFrameDistance) % frameCapacity),
+                        observationLength, nextObservation + i * observationLength);
+    ReplayCodec::decode(config.replayActionFormat, record + actionOffset,
+                        actionLength, action + i * actionLength);
+    std::memcpy(reward + i, record + rewardOffset, sizeof(float));
+    uint32_t flags;
+    std::memcpy(&flags, record + flagsOffset, sizeof(uint32_t));
+    done[i] = ((flags & doneFlag) != 0 ? 1 : 0);
+  }
+  return batch;
 }
 
-SamplePtrs ReplayBuffer::sampleBatch() {
-  if (buffer.empty()) {
-    return {};
+void ReplayBuffer::updatePriorities(const Batch &batch) {
+  if (priorities == nullptr) {
+    return;
   }
 
-  SamplePtrs samples(config.batchSize, nullptr);
-  std::uniform_int_distribution<int> indexDistribution(0, static_cast<int>(buffer.size()) - 1);
+  PROFILE_SCOPE("ReplayBuffer::updatePriorities");
+  const auto *tdError = batch.tdError.data_ptr<float>();
   for (int i = 0; i < config.batchSize; i++) {
-    samples[i] = buffer[indexDistribution(randomGenerator)];
+    const auto priority = std::pow(std::abs(tdError[i]) + config.priorityEpsilon,
+                                   config.priorityAlpha);
+    priorities->set(batch.indices[i], priority);
+    priorityMax = std::max(priorityMax, priority);
+  }
+}
+
+bool ReplayBuffer::empty() const {
+  return (size == 0);
+}
+
+bool ReplayBuffer::frameAvailable(int64_t frame, int64_t margin) const {
+  return (frame >= 0) && (frameCount - frame + margin <= frameCapacity);
+}
+
+int64_t ReplayBuffer::transitionFrame(int index) const {
+  int64_t frame;
+  std::memcpy(&frame, storage->record(index) + frameOffset, sizeof(int64_t));
+  return frame;
+}
+
+// The transitions that reference the overwritten frame are retired first. As frames
+// never decrease from the tail, they are always the oldest ones.
+int64_t ReplayBuffer::writeFrame(const char *encodedFrame) {
+  const auto evictedFrame = frameCount - frameCapacity;
+  while ((size > 0) && (transitionFrame(tail) <= evictedFrame)) {
+    if (priorities != nullptr) {
+      priorities->clear(tail);
+    }
+    tail = (tail + 1) % capacity;
+    size--;
+  }
+  const auto index = frameCount % frameCapacity;
+  std::memcpy(frames->record(index), encodedFrame, frameStride);
+  frames->written(index);
+  dirtyChunks[transitionChunkCount + index / chunkLength] = true;
+  return frameCount++;
+}
+
+int ReplayBuffer::chunkCount() const {
+  return static_cast<int>(dirtyChunks.size());
+}
+
+void ReplayBuffer::saveState(std::ostream &stream) const {
+  writeBinary<int32_t>(stream, capacity);
+  writeBinary<int32_t>(stream, observationLength);
+  writeBinary<int32_t>(stream, actionLength);
+  writeBinary<int32_t>(stream, static_cast<int32_t>(config.replayObservationFormat));
+  writeBinary<int32_t>(stream, static_cast<int32_t>(config.replayActionFormat));
+  writeBinary<int32_t>(stream, cursor);
+  writeBinary<int32_t>(stream, tail);
+  writeBinary<int32_t>(stream, size);
+  writeBinary<int64_t>(stream, frameCapacity);
+  writeBinary<int64_t>(stream, frameCount);
+  writeBinary<int64_t>(stream, lastFrame);
+  writeBinary<int32_t>(stream, static_cast<int32_t>(streamFrames.size()));
+  writeBinary(stream, streamFrames.data(), streamFrames.size());
+  writeBinary<float>(stream, priorityMax);
+  writeEngine(stream, randomGenerator);
+  writeBinary<bool>(stream, priorities != nullptr);
+  if (priorities != nullptr) {
+    for (int i = 0; i < size; i++) {
+      writeBinary<float>(stream, priorities->get((tail + i) % capacity));
+    }
+  }
+}
+
+void ReplayBuffer::loadState(std::istream &stream) {
+  if ((readBinary<int32_t>(stream) != capacity) ||
+      (readBinary<int32_t>(stream) != observationLength) ||
+      (readBinary<int32_t>(stream) != actionLength) ||
+      (readBinary<int32_t>(stream) != static_cast<int32_t>(config.replayObservationFormat)) ||
+      (readBinary<int32_t>(stream) != static_cast<int32_t>(config.replayActionFormat))) {
+    EXCEPT("Replay buffer state does not match configuration");
+  }
+  cursor = readBinary<int32_t>(stream);
+  tail = readBinary<int32_t>(stream);
+  size = readBinary<int32_t>(stream);
+  if (readBinary<int64_t>(stream) != frameCapacity) {
+    EXCEPT("Replay buffer state does not match configuration");
+  }
+  frameCount = readBinary<int64_t>(stream);
+  lastFrame = readBinary<int64_t>(stream);
+  streamFrames.resize(readBinary<int32_t>(stream));
+  readBinary(stream, streamFrames.data(), streamFrames.size());
+  priorityMax = readBinary<float>(stream);
+  readEngine(stream, randomGenerator);
+  const auto prioritized = readBinary<bool>(stream);
+  for (int i = 0; prioritized && (i < size); i++) {
+    const auto priority = readBinary<float>(stream);
+    if (priorities != nullptr) {
+      priorities->set((tail + i) % capacity, priority);
+    }
+  }
+  if ((priorities != nullptr) && !prioritized) {
+    for (int i = 0; i < size; i++) {
+      priorities->set((tail + i) % capacity, priorityMax);
+    }
+  }
+}
+
+// Chunks below transitionChunkCount hold transition records, the rest hold frames.
+void ReplayBuffer::saveChunk(int chunk, std::ostream &stream) const {
+  const auto &chunkStorage = (chunk < transitionChunkCount ? *storage : *frames);
+  const auto begin = static_cast<size_t>(chunk < transitionChunkCount
+                                         ? chunk : chunk - transitionChunkCount) * chunkLength;
+  const auto count = std::min<size_t>(chunkLength, chunkStorage.capacity - begin);
+  writeBinary<int32_t>(stream, chunk);
+  writeBinary<int32_t>(stream, count);
+  writeBinary<int64_t>(stream, chunkStorage.stride);
+  writeBinary(stream, chunkStorage.record(begin), count * chunkStorage.stride);
+}
+
+void ReplayBuffer::loadChunk(int chunk, std::istream &stream) {
+  auto &chunkStorage = (chunk < transitionChunkCount ? *storage : *frames);
+  const auto begin = static_cast<size_t>(chunk < transitionChunkCount
+                                         ? chunk : chunk - transitionChunkCount) * chunkLength;
+  const auto count = std::min<size_t>(chunkLength, chunkStorage.capacity - begin);
+  if ((readBinary<int32_t>(stream) != chunk) ||
+      (readBinary<int32_t>(stream) != static_cast<int32_t>(count)) ||
+      (readBinary<int64_t>(stream) != static_cast<int64_t>(chunkStorage.stride))) {
+    EXCEPT("Replay chunk does not match buffer");
   }
-  return samples;
+  readBinary(stream, chunkStorage.record(begin), count * chunkStorage.stride);
+  dirtyChunks[chunk] = false;
 }
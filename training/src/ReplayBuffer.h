@@ -3,18 +3,72 @@
 #define REPLAYBUFFER_H
 
 #include "Config.h"
+#include "Model.h"
+
+struct Batch {
+  torch::Tensor observation;
+  torch::Tensor action;
+  torch::Tensor reward;
+  torch::Tensor nextObservation;
+  torch::Tensor done;
+  torch::Tensor weight;
+  torch::Tensor tdError;
+  Array<int> indices;
+};
 
 class ReplayBuffer {
 public:
-  ReplayBuffer(const Config &config);
+  ReplayBuffer(const Config &config, int observationLength, int actionLength);
+
+  void append(int stream, const float *observation, const float *action, float reward,
+              const float *nextObservation, bool done);
+  Batch& sampleBatch();
+  void updatePriorities(const Batch &batch);
 
-  void append(SamplePtr sample);
-  SamplePtrs sampleBatch();
+  bool empty() const;
+
+  int chunkCount() const;
+  void saveState(std::ostream &stream) const;
+  void loadState(std::istream &stream);
+  void saveChunk(int chunk, std::ostream &stream) const;
+  void loadChunk(int chunk, std::istream &stream);
+
+  static constexpr int chunkLength = 1 << 16;
+  static constexpr int frameReserve = 1024;
+  static constexpr uint32_t doneFlag = 1;
 
   Config config;
+  int observationLength;
+  int actionLength;
+  int capacity;
   int cursor;
-  SamplePtrs buffer;
+  int tail;
+  int size;
+  int64_t frameCapacity;
+  int64_t frameCount;
+  int64_t lastFrame;
+  size_t frameStride;
+  size_t frameOffset;
+  size_t nextFrameOffset;
+  size_t actionOffset;
+  size_t rewardOffset;
+  size_t flagsOffset;
+  size_t stride;
+  ReplayStoragePtr storage;
+  ReplayStoragePtr frames;
+  Array<int64_t> streamFrames;
+  Array<char> encodedObservation;
+  int transitionChunkCount;
+  Array<bool> dirtyChunks;
+  SumTreePtr priorities;
+  float priorityMax;
+  Batch batch;
   std::default_random_engine randomGenerator;
+
+private:
+  bool frameAvailable(int64_t frame, int64_t margin) const;
+  int64_t transitionFrame(int index) const;
+  int64_t writeFrame(const char *encodedFrame);
 };
 
 #endif // REPLAYBUFFER_H
@@ -0,0 +1,108 @@
+
+#include "ReplayCodec.h"
+#include "ReplayCodecKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const float int16Scale = 32767;
+static const float int8Scale = 127;
+
+template<typename T>
+static void quantize(const float *values, int length, float scale, char *data) {
+  for (int i = 0; i < length; i++) {
+    const auto value = std::round(std::clamp(values[i], -1.0f, 1.0f) * scale);
+    const auto quantized = static_cast<T>(value);
+    std::memcpy(data + i * sizeof(T), &quantized, sizeof(T));
+  }
+}
+
+size_t ReplayCodec::size(ObservationFormat format, int length) {
+  return length * (format == ObservationFormat::Float32 ? sizeof(float) : sizeof(uint16_t));
+}
+
+size_t ReplayCodec::size(ActionFormat format, int length) {
+  switch (format) {
+  case ActionFormat::Int16:
+    return length * sizeof(int16_t);
+  case ActionFormat::Int8:
+    return length * sizeof(int8_t);
+  default:
+    return length * sizeof(float);
+  }
+}
+
+void ReplayCodec::encode(ObservationFormat format, const float *values, int length, char *data) {
+  switch (format) {
+  case ObservationFormat::Float16:
+    ReplayCodecKernel::encodeHalf(values, length, data);
+    break;
+  case ObservationFormat::BFloat16:
+    ReplayCodecKernel::encodeBFloat16(values, length, data);
+    break;
+  default:
+    std::memcpy(data, values, length * sizeof(float));
+  }
+}
+
+void ReplayCodec::decode(ObservationFormat format, const char *data, int length, float *values) {
+  switch (format) {
+  case ObservationFormat::Float16:
+    ReplayCodecKernel::decodeHalf(data, length, values);
+    break;
+  case ObservationFormat::BFloat16:
+    ReplayCodecKernel::decodeBFloat16(data, length, values);
+    break;
+  default:
+    std::memcpy(values, data, length * sizeof(float));
+  }
+}
+
+void ReplayCodec::encode(ActionFormat format, const float *values, int length, char *data) {
+  switch (format) {
+  case ActionFormat::Int16:
+    quantize<int16_t>(values, length, int16Scale, data);
+    break;
+  case ActionFormat::Int8:
+    quantize<int8_t>(values, length, int8Scale, data);
+    break;
+  default:
+    std::memcpy(data, values, length * sizeof(float));
+  }
+}
+
+void ReplayCodec::decode(ActionFormat format, const char *data, int length, float *values) {
+  switch (format) {
+  case ActionFormat::Int16:
+    ReplayCodecKernel::decodeInt16(data, length, 1 / int16Scale, values);
+    break;
+  case ActionFormat::Int8:
+    ReplayCodecKernel::decodeInt8(data, length, 1 / int8Scale, values);
+    break;
+  default:
+    std::memcpy(values, data, length * sizeof(float));
+  }
+}
+
+ObservationFormat ReplayCodec::parseObservationFormat(const String &name) {
+  if (name == "float32") {
+    return ObservationFormat::Float32;
+  } else if (name == "float16") {
+    return ObservationFormat::Float16;
+  } else if (name == "bfloat16") {
+    return ObservationFormat::BFloat16;
+  }
+  EXCEPT("Invalid observation format: " + name);
+}
+
+ActionFormat ReplayCodec::parseActionFormat(const String &name) {
+  if (name == "float32") {
+    return ActionFormat::Float32;
+  } else if (name == "int16") {
+    return ActionFormat::Int16;
+  } else if (name == "int8") {
+    return ActionFormat::Int8;
+  }
+  EXCEPT("Invalid action format: " + name);
+}
@@ -0,0 +1,21 @@
+
+#ifndef REPLAYCODEC_H
+#define REPLAYCODEC_H
+
+#include "Types.h"
+
+class ReplayCodec {
+public:
+  static size_t size(ObservationFormat format, int length);
+  static size_t size(ActionFormat format, int length);
+
+  static void encode(ObservationFormat format, const float *values, int length, char *data);
+  static void decode(ObservationFormat format, const char *data, int length, float *values);
+  static void encode(ActionFormat format, const float *values, int length, char *data);
+  static void decode(ActionFormat format, const char *data, int length, float *values);
+
+  static ObservationFormat parseObservationFormat(const String &name);
+  static ActionFormat parseActionFormat(const String &name);
+};
+
+#endif // REPLAYCODEC_H
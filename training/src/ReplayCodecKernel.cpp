@@ -0,0 +1,248 @@
+
+#include "ReplayCodecKernel.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define REPLAY_CODEC_AVX2
+#define AVX2_TARGET __attribute__((target("avx2,f16c")))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define REPLAY_CODEC_NEON
+#endif
+
+static inline uint32_t floatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float bitsFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Round to nearest even, saturating to infinity and keeping NaN quiet
+static uint16_t floatToHalf(float value) {
+  const uint32_t infinityBits = 255u << 23;
+  const uint32_t halfMaximumBits = (127u + 16) << 23;
+  const uint32_t denormalMagicBits = ((127u - 15) + (23 - 10) + 1) << 23;
+  auto bits = floatBits(value);
+  const auto sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint32_t half;
+  if (bits >= halfMaximumBits) {
+    half = (bits > infinityBits ? 0x7e00 : 0x7c00);
+  } else if (bits < (113u << 23)) {
+    half = floatBits(bitsFloat(bits) + bitsFloat(denormalMagicBits)) - denormalMagicBits;
+  } else {
+    const auto mantissaOdd = (bits >> 13) & 1;
+    bits += ((15u - 127) << 23) + 0xfff + mantissaOdd;
+    half = bits >> 13;
+  }
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+static float halfToFloat(uint16_t half) {
+  const uint32_t shiftedExponent = 0x7c00u << 13;
+  auto bits = static_cast<uint32_t>(half & 0x7fff) << 13;
+  const auto exponent = shiftedExponent & bits;
+  bits += (127u - 15) << 23;
+  if (exponent == shiftedExponent) {
+    bits += (128u - 16) << 23;
+  } else if (exponent == 0) {
+    bits += 1u << 23;
+    bits = floatBits(bitsFloat(bits) - bitsFloat(113u << 23));
+  }
+  return bitsFloat(bits | (static_cast<uint32_t>(half & 0x8000) << 16));
+}
+
+static uint16_t floatToBFloat16(float value) {
+  const auto bits = floatBits(value);
+  if (std::isnan(value)) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40);
+  }
+  return static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+static float bFloat16ToFloat(uint16_t value) {
+  return bitsFloat(static_cast<uint32_t>(value) << 16);
+}
+
+
+#ifdef REPLAY_CODEC_AVX2
+// Each function converts whole lanes and returns the count, leaving the rest to the scalar loop.
+AVX2_TARGET static int encodeHalfAvx2(const float *values, int length, char *data) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const auto half = _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i * 2), half);
+  }
+  return i;
+}
+
+AVX2_TARGET static int decodeHalfAvx2(const char *data, int length, float *values) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const auto half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+    _mm256_storeu_ps(values + i, _mm256_cvtph_ps(half));
+  }
+  return i;
+}
+
+AVX2_TARGET static int decodeBFloat16Avx2(const char *data, int length, float *values) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+    const auto bits = _mm256_slli_epi32(_mm256_cvtepu16_epi32(packed), 16);
+    _mm256_storeu_ps(values + i, _mm256_castsi256_ps(bits));
+  }
+  return i;
+}
+
+AVX2_TARGET static int decodeInt16Avx2(const char *data, int length, float scale,
+                                       float *values) {
+  const auto scaleLanes = _mm256_set1_ps(scale);
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+    const auto wide = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(packed));
+    _mm256_storeu_ps(values + i, _mm256_mul_ps(wide, scaleLanes));
+  }
+  return i;
+}
+
+AVX2_TARGET static int decodeInt8Avx2(const char *data, int length, float scale,
+                                      float *values) {
+  const auto scaleLanes = _mm256_set1_ps(scale);
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data + i));
+    const auto wide = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(packed));
+    _mm256_storeu_ps(values + i, _mm256_mul_ps(wide, scaleLanes));
+  }
+  return i;
+}
+
+static bool avx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+}
+
+static const bool useAvx2 = avx2Supported();
+#else
+static const bool useAvx2 = false;
+#endif
+
+void ReplayCodecKernel::encodeHalf(const float *values, int length, char *data) {
+  int i = 0;
+#if defined(REPLAY_CODEC_AVX2)
+  if (useAvx2) {
+    i = encodeHalfAvx2(values, length, data);
+  }
+#elif defined(REPLAY_CODEC_NEON)
+  for (; i + 4 <= length; i += 4) {
+    vst1_f16(reinterpret_cast<float16_t*>(data + i * 2), vcvt_f16_f32(vld1q_f32(values + i)));
+  }
+#endif
+  for (; i < length; i++) {
+    const auto half = floatToHalf(values[i]);
+    std::memcpy(data + i * 2, &half, 2);
+  }
+}
+
+void ReplayCodecKernel::decodeHalf(const char *data, int length, float *values) {
+  int i = 0;
+#if defined(REPLAY_CODEC_AVX2)
+  if (useAvx2) {
+    i = decodeHalfAvx2(data, length, values);
+  }
+#elif defined(REPLAY_CODEC_NEON)
+  for (; i + 4 <= length; i += 4) {
+    vst1q_f32(values + i, vcvt_f32_f16(vld1_f16(reinterpret_cast<const float16_t*>(data + i * 2))));
+  }
+#endif
+  for (; i < length; i++) {
+    uint16_t half;
+    std::memcpy(&half, data + i * 2, 2);
+    values[i] = halfToFloat(half);
+  }
+}
+
+void ReplayCodecKernel::encodeBFloat16(const float *values, int length, char *data) {
+  for (int i = 0; i < length; i++) {
+    const auto value = floatToBFloat16(values[i]);
+    std::memcpy(data + i * 2, &value, 2);
+  }
+}
+
+void ReplayCodecKernel::decodeBFloat16(const char *data, int length, float *values) {
+  int i = 0;
+#if defined(REPLAY_CODEC_AVX2)
+  if (useAvx2) {
+    i = decodeBFloat16Avx2(data, length, values);
+  }
+#elif defined(REPLAY_CODEC_NEON)
+  for (; i + 4 <= length; i += 4) {
+    const auto bits = vshll_n_u16(vld1_u16(reinterpret_cast<const uint16_t*>(data + i * 2)), 16);
+    vst1q_f32(values + i, vreinterpretq_f32_u32(bits));
+  }
+#endif
+  for (; i < length; i++) {
+    uint16_t value;
+    std::memcpy(&value, data + i * 2, 2);
+    values[i] = bFloat16ToFloat(value);
+  }
+}
+
+void ReplayCodecKernel::decodeInt16(const char *data, int length, float scale, float *values) {
+  int i = 0;
+#if defined(REPLAY_CODEC_AVX2)
+  if (useAvx2) {
+    i = decodeInt16Avx2(data, length, scale, values);
+  }
+#elif defined(REPLAY_CODEC_NEON)
+  for (; i + 4 <= length; i += 4) {
+    const auto wide = vmovl_s16(vld1_s16(reinterpret_cast<const int16_t*>(data + i * 2)));
+    vst1q_f32(values + i, vmulq_n_f32(vcvtq_f32_s32(wide), scale));
+  }
+#endif
+  for (; i < length; i++) {
+    int16_t value;
+    std::memcpy(&value, data + i * 2, 2);
+    values[i] = value * scale;
+  }
+}
+
+void ReplayCodecKernel::decodeInt8(const char *data, int length, float scale, float *values) {
+  int i = 0;
+#if defined(REPLAY_CODEC_AVX2)
+  if (useAvx2) {
+    i = decodeInt8Avx2(data, length, scale, values);
+  }
+#elif defined(REPLAY_CODEC_NEON)
+  for (; i + 8 <= length; i += 8) {
+    const auto wide = vmovl_s8(vld1_s8(reinterpret_cast<const int8_t*>(data + i)));
+    vst1q_f32(values + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(wide))), scale));
+    vst1q_f32(values + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(wide))), scale));
+  }
+#endif
+  for (; i < length; i++) {
+    values[i] = static_cast<int8_t>(data[i]) * scale;
+  }
+}
+
+const char* ReplayCodecKernel::instructionSet() {
+  if (useAvx2) {
+    return "avx2";
+  }
+#if defined(REPLAY_CODEC_NEON)
+  return "neon";
+#else
+  return "generic";
+#endif
+}
@@ -0,0 +1,19 @@
+
+#ifndef REPLAYCODECKERNEL_H
+#define REPLAYCODECKERNEL_H
+
+// Kept free of torch and shared headers, so that its translation unit may be
+// compiled for another instruction set without breaking inline functions.
+class ReplayCodecKernel {
+public:
+  static void encodeHalf(const float *values, int length, char *data);
+  static void decodeHalf(const char *data, int length, float *values);
+  static void encodeBFloat16(const float *values, int length, char *data);
+  static void decodeBFloat16(const char *data, int length, float *values);
+  static void decodeInt16(const char *data, int length, float scale, float *values);
+  static void decodeInt8(const char *data, int length, float scale, float *values);
+
+  static const char* instructionSet();
+};
+
+#endif // REPLAYCODECKERNEL_H
@@ -0,0 +1,123 @@
+
+#include "ReplayStorage.h"
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define REPLAY_STORAGE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <filesystem>
+
+ReplayStorage::ReplayStorage(size_t stride, size_t capacity,
+                             const String &directoryPath, size_t residentCapacity)
+    : stride(stride)
+    , capacity(capacity)
+    , residentCapacity((residentCapacity > 0) && (residentCapacity < capacity) ? residentCapacity : capacity)
+    , releaseInterval(std::max<size_t>(this->residentCapacity / 4, 1))
+    , writeCount(0)
+    , lastIndex(0)
+    , data(nullptr)
+    , length(stride * capacity)
+    , pageSize(4096)
+    , mapped(!directoryPath.empty()) {
+  if (!mapped) {
+    buffer.resize(length);
+    data = buffer.data();
+    return;
+  }
+
+#ifdef REPLAY_STORAGE_MMAP
+  pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  auto filePath = (std::filesystem::path(directoryPath) / "replayXXXXXX").string();
+  const auto descriptor = ::mkstemp(&filePath[0]);
+  if (descriptor < 0) {
+    EXCEPT("Failed to create replay storage in " + directoryPath);
+  }
+  // The file only backs this process, so it is unlinked right away and
+  // vanishes with the mapping.
+  ::unlink(filePath.c_str());
+  if (::ftruncate(descriptor, length) != 0) {
+    ::close(descriptor);
+    EXCEPT("Failed to size replay storage");
+  }
+  auto *address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+  ::close(descriptor);
+  if (address == MAP_FAILED) {
+    EXCEPT("Failed to map replay storage");
+  }
+  data = static_cast<char*>(address);
+  advise(0, length, MADV_RANDOM);
+#else
+  EXCEPT("Memory-mapped replay storage is not supported on this platform");
+#endif
+}
+
+ReplayStorage::~ReplayStorage() {
+#ifdef REPLAY_STORAGE_MMAP
+  if (mapped && (data != nullptr)) {
+    ::munmap(data, length);
+  }
+#endif
+}
+
+char* ReplayStorage::record(size_t index) {
+  return data + index * stride;
+}
+
+const char* ReplayStorage::record(size_t index) const {
+  return data + index * stride;
+}
+
+bool ReplayStorage::resident(size_t index) const {
+  return ((lastIndex + capacity - index) % capacity) < residentCapacity;
+}
+
+void ReplayStorage::prefetch(size_t index) const {
+#ifdef REPLAY_STORAGE_MMAP
+  if (mapped && !resident(index)) {
+    advise(index * stride, (index + 1) * stride, MADV_WILLNEED);
+  }
+#endif
+}
+
+void ReplayStorage::written(size_t index) {
+  lastIndex = index;
+  if (!mapped || (residentCapacity == capacity) || (++writeCount % releaseInterval != 0)) {
+    return;
+  }
+
+  // Everything outside the window of the most recent records is dropped from
+  // the process, the page cache keeps it until it is sampled again.
+  const auto begin = (index + 1) % capacity;
+  const auto end = begin + capacity - residentCapacity;
+  if (end <= capacity) {
+    release(begin, end);
+  } else {
+    release(begin, capacity);
+    release(0, end - capacity);
+  }
+}
+
+void ReplayStorage::advise(size_t begin, size_t end, int advice) const {
+#ifdef REPLAY_STORAGE_MMAP
+  begin = begin / pageSize * pageSize;
+  end = std::min((end + pageSize - 1) / pageSize * pageSize, length);
+  if (begin < end) {
+    ::madvise(data + begin, end - begin, advice);
+  }
+#endif
+}
+
+void ReplayStorage::release(size_t begin, size_t end) {
+#ifdef REPLAY_STORAGE_MMAP
+  // Pages shared with the window are kept, so the range is shrunk inwards
+  const auto first = (begin * stride + pageSize - 1) / pageSize * pageSize;
+  const auto last = end * stride / pageSize * pageSize;
+  if (first < last) {
+    ::madvise(data + first, last - first, MADV_DONTNEED);
+  }
+#endif
+}
@@ -0,0 +1,38 @@
+
+#ifndef REPLAYSTORAGE_H
+#define REPLAYSTORAGE_H
+
+#include "Types.h"
+
+class ReplayStorage {
+public:
+  ReplayStorage(size_t stride, size_t capacity,
+                const String &directoryPath = "", size_t residentCapacity = 0);
+  ReplayStorage(const ReplayStorage &storage) = delete;
+  ~ReplayStorage();
+
+  char* record(size_t index);
+  const char* record(size_t index) const;
+
+  bool resident(size_t index) const;
+  void prefetch(size_t index) const;
+  void written(size_t index);
+
+  size_t stride;
+  size_t capacity;
+  size_t residentCapacity;
+  size_t releaseInterval;
+  size_t writeCount;
+  size_t lastIndex;
+  Array<char> buffer;
+  char *data;
+  size_t length;
+  size_t pageSize;
+  bool mapped;
+
+private:
+  void advise(size_t begin, size_t end, int advice) const;
+  void release(size_t begin, size_t end);
+};
+
+#endif // REPLAYSTORAGE_H
@@ -0,0 +1,75 @@
+
+#include "SumTree.h"
+
+#include <algorithm>
+#include <limits>
+
+SumTree::SumTree(int capacity)
+    : leafCount(2) {
+  while (leafCount < capacity) {
+    leafCount *= 2;
+  }
+  sums.assign(2 * leafCount, 0);
+  minimums.assign(2 * leafCount, std::numeric_limits<float>::infinity());
+}
+
+void SumTree::set(int index, float priority) {
+  const auto node = leafCount + index;
+  sums[node] = priority;
+  minimums[node] = priority;
+  dirtyNodes.push_back(node / 2);
+}
+
+// Unlike a zero priority, a cleared leaf is also left out of the minimum.
+void SumTree::clear(int index) {
+  const auto node = leafCount + index;
+  sums[node] = 0;
+  minimums[node] = std::numeric_limits<float>::infinity();
+  dirtyNodes.push_back(node / 2);
+}
+
+void SumTree::flush() {
+  // Parents are refreshed level by level so that every inner node is
+  // recomputed once per flush, however many of its leaves have changed.
+  while (!dirtyNodes.empty()) {
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    dirtyNodes.erase(std::unique(dirtyNodes.begin(), dirtyNodes.end()), dirtyNodes.end());
+    for (const auto node : dirtyNodes) {
+      sums[node] = sums[2 * node] + sums[2 * node + 1];
+      minimums[node] = std::min(minimums[2 * node], minimums[2 * node + 1]);
+    }
+    if (dirtyNodes.front() == 1) {
+      dirtyNodes.clear();
+      break;
+    }
+    for (auto &node : dirtyNodes) {
+      node /= 2;
+    }
+  }
+}
+
+float SumTree::get(int index) const {
+  return static_cast<float>(sums[leafCount + index]);
+}
+
+double SumTree::total() const {
+  return sums[1];
+}
+
+float SumTree::minimum() const {
+  return minimums[1];
+}
+
+int SumTree::find(double value) const {
+  int node = 1;
+  while (node < leafCount) {
+    const auto left = 2 * node;
+    if ((value < sums[left]) || (sums[left + 1] <= 0)) {
+      node = left;
+    } else {
+      value -= sums[left];
+      node = left + 1;
+    }
+  }
+  return node - leafCount;
+}
@@ -0,0 +1,27 @@
+
+#ifndef SUMTREE_H
+#define SUMTREE_H
+
+#include "Types.h"
+
+class SumTree {
+public:
+  SumTree(int capacity);
+
+  void set(int index, float priority);
+  void clear(int index);
+  void flush();
+
+  float get(int index) const;
+  double total() const;
+  float minimum() const;
+
+  int find(double value) const;
+
+  int leafCount;
+  Array<double> sums;
+  Array<float> minimums;
+  Array<int> dirtyNodes;
+};
+
+#endif // SUMTREE_H
@@ -0,0 +1,107 @@
+
+#include "TaskPool.h"
+
+#include <algorithm>
+
+static thread_local bool insideTask = false;
+
+TaskPool& TaskPool::instance() {
+  static TaskPool pool;
+  return pool;
+}
+
+TaskPool::TaskPool()
+    : workerCount(0)
+    , running(true) {
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  condition.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void TaskPool::reserve(int threadCount) {
+  std::lock_guard<std::mutex> lock(mutex);
+  while (static_cast<int>(threads.size()) + 1 < threadCount) {
+    threads.emplace_back(&TaskPool::run, this);
+  }
+  workerCount.store(static_cast<int>(threads.size()), std::memory_order_release);
+}
+
+int TaskPool::threadCount() const {
+  return workerCount.load(std::memory_order_acquire) + 1;
+}
+
+void TaskPool::parallelFor(int begin, int end, int grainSize, const Body &body) {
+  grainSize = std::max(grainSize, 1);
+  if ((end - begin <= grainSize) || (workerCount.load(std::memory_order_acquire) == 0) || insideTask) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+
+  Job job;
+  job.body = &body;
+  job.end = end;
+  job.grainSize = grainSize;
+  job.next.store(begin, std::memory_order_relaxed);
+  job.users.store(0, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(&job);
+  }
+  condition.notify_all();
+
+  process(job);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto position = std::find(jobs.begin(), jobs.end(), &job);
+    if (position != jobs.end()) {
+      jobs.erase(position);
+    }
+  }
+  while (job.users.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+}
+
+void TaskPool::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    condition.wait(lock, [this]() { return !running || !jobs.empty(); });
+    if (!running) {
+      return;
+    }
+
+    auto *job = jobs.front();
+    if (job->next.load(std::memory_order_relaxed) >= job->end) {
+      jobs.pop_front();
+      continue;
+    }
+    job->users.fetch_add(1, std::memory_order_relaxed);
+    lock.unlock();
+    process(*job);
+    job->users.fetch_sub(1, std::memory_order_release);
+    lock.lock();
+  }
+}
+
+void TaskPool::process(Job &job) {
+  insideTask = true;
+  while (true) {
+    const auto begin = job.next.fetch_add(job.grainSize, std::memory_order_relaxed);
+    if (begin >= job.end) {
+      break;
+    }
+    (*job.body)(begin, std::min(begin + job.grainSize, job.end));
+  }
+  insideTask = false;
+}
@@ -0,0 +1,52 @@
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include "Types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Process-wide worker pool shared by vector environments and the Bullet task scheduler.
+// The calling thread takes part in every loop; loops started from inside a task run inline.
+class TaskPool {
+public:
+  typedef std::function<void(int, int)> Body;
+
+  static TaskPool& instance();
+
+  TaskPool(const TaskPool &pool) = delete;
+  ~TaskPool();
+
+  void reserve(int threadCount);
+  int threadCount() const;
+
+  void parallelFor(int begin, int end, int grainSize, const Body &body);
+
+private:
+  struct Job {
+    const Body *body;
+    int end;
+    int grainSize;
+    std::atomic<int> next;
+    std::atomic<int> users;
+  };
+
+  TaskPool();
+
+  void run();
+  static void process(Job &job);
+
+  Array<std::thread> threads;
+  std::atomic<int> workerCount;
+  std::deque<Job*> jobs;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool running;
+};
+
+#endif // TASKPOOL_H
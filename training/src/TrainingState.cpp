@@ -0,0 +1,239 @@
+
+#include "TrainingState.h"
+#include "Coach.h"
+#include "ReplayBuffer.h"
+#include "Learner.h"
+#include "ActorSnapshot.h"
+#include "CheckpointWriter.h"
+#include "BinaryStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+static const std::array<char, 4> stateMagic = {'T', 'W', 'S', '2'};
+static const char *stateFileName = "state.bin";
+static const char *chunkFilePrefix = "replay";
+static const char *chunkFileExtension = ".bin";
+
+// Every generation writes its dirty chunks to new files, so that the files referenced by the
+// last committed state.bin stay intact until a newer state.bin replaces it.
+static String chunkFileName(int chunk, int64_t generation) {
+  return chunkFilePrefix + std::to_string(chunk) + "-" + std::to_string(generation) +
+         chunkFileExtension;
+}
+
+TrainingState::TrainingState(const String &directoryPath)
+    : directoryPath(directoryPath)
+    , generation(0)
+    , step(0)
+    , trainingStep(0)
+    , epochStep(0)
+    , advance(0)
+    , trainCount(0)
+    , dataOffset(0) {
+}
+
+bool TrainingState::exists() const {
+  return std::filesystem::exists(filePath(stateFileName));
+}
+
+String TrainingState::filePath(const String &fileName) const {
+  return (std::filesystem::path(directoryPath) / fileName).string();
+}
+
+uint64_t TrainingState::checksum(const String &data) {
+  // FNV-1a over 64-bit words, followed by the remaining bytes
+  const uint64_t prime = 0x100000001b3;
+  uint64_t hash = 0xcbf29ce484222325;
+  size_t offset = 0;
+  for (; offset + sizeof(uint64_t) <= data.size(); offset += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, data.data() + offset, sizeof(uint64_t));
+    hash = (hash ^ word) * prime;
+  }
+  for (; offset < data.size(); offset++) {
+    hash = (hash ^ static_cast<unsigned char>(data[offset])) * prime;
+  }
+  return hash;
+}
+
+void TrainingState::read() {
+  std::ifstream file(filePath(stateFileName), std::ios::binary);
+  if (!file) {
+    EXCEPT("Failed to open " + filePath(stateFileName));
+  }
+  data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if (data.size() < sizeof(uint64_t)) {
+    EXCEPT("Invalid training state");
+  }
+  uint64_t stateChecksum;
+  std::memcpy(&stateChecksum, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+  data.resize(data.size() - sizeof(uint64_t));
+  if (checksum(data) != stateChecksum) {
+    EXCEPT("Training state checksum mismatch");
+  }
+
+  std::istringstream stream(data);
+  std::array<char, 4> magic = {};
+  readBinary(stream, magic.data(), magic.size());
+  if (magic != stateMagic) {
+    EXCEPT("Invalid training state");
+  }
+  generation = readBinary<int64_t>(stream);
+  chunks.resize(readBinary<int64_t>(stream));
+  for (auto &chunk : chunks) {
+    chunk.generation = readBinary<int64_t>(stream);
+    chunk.checksum = readBinary<uint64_t>(stream);
+  }
+  step = readBinary<int64_t>(stream);
+  trainingStep = readBinary<int64_t>(stream);
+  epochStep = readBinary<int64_t>(stream);
+  advance = readBinary<int64_t>(stream);
+  trainCount = readBinary<int64_t>(stream);
+  dataOffset = stream.tellg();
+}
+
+void TrainingState::restore(Coach &coach) {
+  std::istringstream stream(data);
+  stream.seekg(dataOffset);
+  coach.network->loadState(stream);
+  auto &replayBuffer = *coach.replayBuffer;
+  replayBuffer.loadState(stream);
+  const auto environmentCount = readBinary<int64_t>(stream);
+  for (int64_t i = 0; i < environmentCount; i++) {
+    RandomGenerator randomGenerator;
+    readEngine(stream, randomGenerator);
+    if ((coach.environment != nullptr) && (i < coach.environment->size())) {
+      coach.environment->environments[i]->getRandomGenerator() = randomGenerator;
+    }
+  }
+
+  if (chunks.size() != static_cast<size_t>(replayBuffer.chunkCount())) {
+    EXCEPT("Training state does not match replay buffer");
+  }
+  const auto loadChunk = [&](int chunk) {
+    if (chunks[chunk].generation < 0) {
+      EXCEPT("Missing replay chunk " + std::to_string(chunk));
+    }
+    const auto chunkFilePath = filePath(chunkFileName(chunk, chunks[chunk].generation));
+    std::ifstream file(chunkFilePath, std::ios::binary);
+    if (!file) {
+      EXCEPT("Failed to open " + chunkFilePath);
+    }
+    const String chunkData((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    if (checksum(chunkData) != chunks[chunk].checksum) {
+      EXCEPT("Replay chunk checksum mismatch in " + chunkFilePath);
+    }
+    std::istringstream stream(chunkData);
+    replayBuffer.loadChunk(chunk, stream);
+  };
+  // Live transitions run from the tail for size records, possibly wrapping around
+  const auto live = [&](int index) {
+    return (index - replayBuffer.tail + replayBuffer.capacity) % replayBuffer.capacity <
+           replayBuffer.size;
+  };
+  for (int i = 0; i < replayBuffer.transitionChunkCount; i++) {
+    const auto begin = i * ReplayBuffer::chunkLength;
+    const auto end = std::min(begin + ReplayBuffer::chunkLength, replayBuffer.capacity);
+    if (live(begin) ||
+        ((replayBuffer.size > 0) && (replayBuffer.tail >= begin) && (replayBuffer.tail < end))) {
+      loadChunk(i);
+    }
+  }
+  const auto filledFrameCount = std::min(replayBuffer.frameCount, replayBuffer.frameCapacity);
+  const auto filledFrameChunkCount = static_cast<int>(
+      (filledFrameCount + ReplayBuffer::chunkLength - 1) / ReplayBuffer::chunkLength);
+  for (int i = 0; i < filledFrameChunkCount; i++) {
+    loadChunk(replayBuffer.transitionChunkCount + i);
+  }
+
+  coach.advance = advance;
+  coach.trainCount = trainCount;
+  coach.publishedTrainCount = trainCount;
+  // Workers already act with the snapshot of the network the coach was built with
+  if (coach.snapshot != nullptr) {
+    coach.snapshot->publish(*coach.network->model->actor);
+  }
+  data.clear();
+}
+
+void TrainingState::save(Coach &coach, CheckpointWriter &writer) {
+  std::filesystem::create_directories(directoryPath);
+
+  auto &replayBuffer = *coach.replayBuffer;
+  generation++;
+  chunks.resize(replayBuffer.chunkCount(), {-1, 0});
+  for (int i = 0; i < replayBuffer.chunkCount(); i++) {
+    if (!replayBuffer.dirtyChunks[i]) {
+      continue;
+    }
+    std::ostringstream stream;
+    replayBuffer.saveChunk(i, stream);
+    auto chunkData = stream.str();
+    chunks[i] = {generation, checksum(chunkData)};
+    writer.submit(filePath(chunkFileName(i, generation)), std::move(chunkData));
+    replayBuffer.dirtyChunks[i] = false;
+  }
+
+  advance = coach.advance;
+  trainCount = (coach.learner != nullptr ? coach.learner->trainCount : coach.trainCount);
+
+  std::ostringstream stream;
+  writeBinary(stream, stateMagic.data(), stateMagic.size());
+  writeBinary<int64_t>(stream, generation);
+  writeBinary<int64_t>(stream, chunks.size());
+  for (const auto &chunk : chunks) {
+    writeBinary<int64_t>(stream, chunk.generation);
+    writeBinary<uint64_t>(stream, chunk.checksum);
+  }
+  writeBinary<int64_t>(stream, step);
+  writeBinary<int64_t>(stream, trainingStep);
+  writeBinary<int64_t>(stream, epochStep);
+  writeBinary<int64_t>(stream, advance);
+  writeBinary<int64_t>(stream, trainCount);
+  coach.network->saveState(stream);
+  replayBuffer.saveState(stream);
+  const int64_t environmentCount = (coach.environment != nullptr ? coach.environment->size() : 0);
+  writeBinary<int64_t>(stream, environmentCount);
+  for (int64_t i = 0; i < environmentCount; i++) {
+    writeEngine(stream, coach.environment->environments[i]->getRandomGenerator());
+  }
+  auto stateData = stream.str();
+  const auto stateChecksum = checksum(stateData);
+  stateData.append(reinterpret_cast<const char*>(&stateChecksum), sizeof(stateChecksum));
+
+  std::set<String> chunkFileNames;
+  for (int i = 0; i < static_cast<int>(chunks.size()); i++) {
+    if (chunks[i].generation >= 0) {
+      chunkFileNames.insert(chunkFileName(i, chunks[i].generation));
+    }
+  }
+  // The writer keeps the submission order, so state.bin is committed after its chunks and
+  // only if all of them were written. The previous chunk files are removed afterwards.
+  const auto stateDirectoryPath = directoryPath;
+  const auto produceState = [stateDirectoryPath, chunkFileNames,
+                             stateData = std::move(stateData)]() {
+    for (const auto &fileName : chunkFileNames) {
+      if (!std::filesystem::exists(std::filesystem::path(stateDirectoryPath) / fileName)) {
+        EXCEPT("Missing replay chunk " + fileName);
+      }
+    }
+    return stateData;
+  };
+  writer.submit(filePath(stateFileName), produceState, [stateDirectoryPath, chunkFileNames]() {
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(stateDirectoryPath, error)) {
+      const auto fileName = entry.path().filename().string();
+      if ((fileName.rfind(chunkFilePrefix, 0) == 0) &&
+          (entry.path().extension() == chunkFileExtension) &&
+          (chunkFileNames.count(fileName) == 0)) {
+        std::filesystem::remove(entry.path(), error);
+      }
+    }
+  });
+}
@@ -0,0 +1,40 @@
+
+#ifndef TRAININGSTATE_H
+#define TRAININGSTATE_H
+
+#include "Types.h"
+
+class CheckpointWriter;
+
+class TrainingState {
+public:
+  TrainingState(const String &directoryPath);
+
+  bool exists() const;
+
+  void read();
+  void restore(Coach &coach);
+  void save(Coach &coach, CheckpointWriter &writer);
+
+  String filePath(const String &fileName) const;
+
+  static uint64_t checksum(const String &data);
+
+  struct Chunk {
+    int64_t generation; // negative until the chunk is first written
+    uint64_t checksum;
+  };
+
+  String directoryPath;
+  int64_t generation;
+  Array<Chunk> chunks;
+  int64_t step;
+  int64_t trainingStep;
+  int64_t epochStep;
+  int64_t advance;
+  int64_t trainCount;
+  String data;
+  size_t dataOffset;
+};
+
+#endif // TRAININGSTATE_H
@@ -48,8 +48,9 @@ void create(const Config &config, const String &data) {
 
   network = std::make_shared<Network>(config, observationLength,
                                       environment->actionLength);
+  const Array<EnvironmentPtr> environments = {std::make_shared<TwistyEnv>(data)};
   coach = std::make_shared<Coach>(config,
-                                  std::make_shared<TwistyEnv>(data),
+                                  std::make_shared<VectorEnvironment>(environments),
                                   network);
 }
 
@@ -57,9 +58,8 @@ StepResult step() {
   if (coach == nullptr) {
     return {0, false};
   }
-  const auto reward = coach->step();
-  const auto done = coach->environment->done || coach->environment->timeout();
-  return {reward, done};
+  coach->step();
+  return {coach->environment->reward[0], coach->environment->finished[0]};
 }
 
 ActorCriticLosses train() {
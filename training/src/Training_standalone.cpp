@@ -2,15 +2,23 @@
 #include "Types.h"
 #include "Config.h"
 #include "TwistyEnv.h"
+#include "PhysicsAutotuner.h"
 #include "Network.h"
 #include "Coach.h"
+#include "Profiler.h"
+#include "CheckpointWriter.h"
+#include "MappedFile.h"
+#include "TrainingState.h"
+#include "ReplayCodec.h"
+#include "Base64.h"
 
 #define RAPIDJSON_HAS_STDSTRING 1
 #include "rapidjson/document.h"
-#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include "rapidjson/error/en.h"
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
@@ -22,16 +30,15 @@ static const int totalSteps = epochs * epochSteps;
 static const int trainingStartSteps = 1000;
 static const int trainingInterval = 50;
 
-static rapidjson::Document loadDocument(const String &filePath) {
+static rapidjson::Document loadDocument(const String &filePath, String &content) {
   std::ifstream file(filePath);
-  String content;
   file.seekg(0, std::ios::end);   
   content.reserve(file.tellg());
   file.seekg(0, std::ios::beg);
   content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
   file.close();
   rapidjson::Document document;
-  if (document.Parse(content).HasParseError()) {
+  if (document.ParseInsitu(content.data()).HasParseError()) {
     std::cerr << "Input is not a valid JSON (offset "
               << document.GetErrorOffset() << "): "
               << rapidjson::GetParseError_En(document.GetParseError())
@@ -41,23 +48,91 @@ static rapidjson::Document loadDocument(const String &filePath) {
   return document;
 }
 
-static void saveDocument(const rapidjson::Document &document, const String &filePath) {
-  std::ofstream file(filePath);
-  rapidjson::OStreamWrapper stream(file);
-  rapidjson::Writer<rapidjson::OStreamWrapper> writer(stream);
+static String writeDocument(const rapidjson::Document &document) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
   document.Accept(writer);
-  file.close();
+  return String(buffer.GetString(), buffer.GetSize());
+}
+
+template<typename T>
+static void readOptional(const rapidjson::Value &object, const char *name, T &value) {
+  if (object.HasMember(name)) {
+    value = object[name].Get<T>();
+  }
+}
+
+static const float defaultAutotuneTolerance = 0.05;
+static const int autotuneStepCount = 1000;
+
+static void printProfile(const Array<Profiler::Event> &events) {
+  const auto phases = Profiler::summarize(events);
+  if (phases.empty()) {
+    return;
+  }
+  std::cout << "Profile   : count total(ms) p50(us) p90(us) p99(us) max(us)" << std::endl;
+  for (const auto &phase : phases) {
+    std::cout << "  " << phase.name << " " << phase.count
+              << " " << phase.totalTime / 1000
+              << " " << phase.medianTime
+              << " " << phase.p90Time
+              << " " << phase.p99Time
+              << " " << phase.maximumTime << std::endl;
+  }
+  const auto arena = PhysicsArena::totalStatistics();
+  if (arena.allocationCount > 0) {
+    std::cout << "Arena     : allocations " << arena.allocationCount
+              << " frees " << arena.deallocationCount
+              << " used(KB) " << arena.usedBytes / 1024
+              << " peak(KB) " << arena.highWaterBytes / 1024
+              << " reserved(KB) " << arena.reservedBytes / 1024 << std::endl;
+  }
 }
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " FILEPATH" << std::endl;
+    std::cerr << "Usage: " << argv[0] << " FILEPATH [--state] [--profile] [--trace FILEPATH] [--trace-epochs COUNT]"
+              << " [--autotune] [--autotune-tolerance DISTANCE]" << std::endl;
     return 1;
   }
 
+  bool saveState = false;
+  bool profile = false;
+  String traceFilePath;
+  int traceEpochs = 1;
+  bool autotune = false;
+  float autotuneTolerance = defaultAutotuneTolerance;
+  for (int i = 2; i < argc; i++) {
+    const String argument = argv[i];
+    if (argument == "--state") {
+      saveState = true;
+    } else if (argument == "--profile") {
+      profile = true;
+    } else if ((argument == "--trace") && (i + 1 < argc)) {
+      profile = true;
+      traceFilePath = argv[++i];
+    } else if ((argument == "--trace-epochs") && (i + 1 < argc)) {
+      traceEpochs = std::stoi(argv[++i]);
+    } else if (argument == "--autotune") {
+      autotune = true;
+    } else if ((argument == "--autotune-tolerance") && (i + 1 < argc)) {
+      autotuneTolerance = std::stof(argv[++i]);
+    } else {
+      std::cerr << "Invalid argument: " << argument << std::endl;
+      return 1;
+    }
+  }
+#ifndef TRAINING_PROFILER
+  if (profile) {
+    std::cerr << "Profiler is not compiled in" << std::endl;
+  }
+#endif
+  Profiler::instance().setEnabled(profile);
+
   const std::filesystem::path inputFilePath(argv[1]);
 
-  auto document = loadDocument(inputFilePath.string());
+  String documentContent;
+  auto document = loadDocument(inputFilePath.string(), documentContent);
   if (!document.HasMember("shapeData")) {
     std::cerr << "Shape data not found" << std::endl;
     return 1;
@@ -66,7 +141,7 @@ int main(int argc, char* argv[]) {
     std::cerr << "Checkpoint not found" << std::endl;
     return 1;
   }
-  if (!document["checkpoint"].HasMember("data")) {
+  if (!document["checkpoint"].HasMember("data") && !document["checkpoint"].HasMember("file")) {
     std::cerr << "Checkpoint data not found" << std::endl;
     return 1;
   }
@@ -97,76 +172,234 @@ int main(int argc, char* argv[]) {
   for (const auto &value : document["config"]["hiddenLayerSizes"].GetArray()) {
     config.hiddenLayerSizes.push_back(value.GetInt());
   }
+  readOptional(document["config"], "replayStoragePath", config.replayStoragePath);
+  readOptional(document["config"], "replayResidentSize", config.replayResidentSize);
+  if (document["config"].HasMember("replayObservationFormat")) {
+    config.replayObservationFormat = ReplayCodec::parseObservationFormat(
+      document["config"]["replayObservationFormat"].GetString());
+  }
+  if (document["config"].HasMember("replayActionFormat")) {
+    config.replayActionFormat = ReplayCodec::parseActionFormat(
+      document["config"]["replayActionFormat"].GetString());
+  }
+  readOptional(document["config"], "prioritizedReplay", config.prioritizedReplay);
+  readOptional(document["config"], "priorityAlpha", config.priorityAlpha);
+  readOptional(document["config"], "priorityBeta", config.priorityBeta);
+  readOptional(document["config"], "priorityEpsilon", config.priorityEpsilon);
+  readOptional(document["config"], "criticCount", config.criticCount);
+  readOptional(document["config"], "environmentCount", config.environmentCount);
+  readOptional(document["config"], "workerCount", config.workerCount);
+  readOptional(document["config"], "asyncLearner", config.asyncLearner);
+  readOptional(document["config"], "updateToDataRatio", config.updateToDataRatio);
+  readOptional(document["config"], "publishInterval", config.publishInterval);
+  if (document["config"].HasMember("physicsBackend")) {
+    config.physics.backend = PhysicsEnv::parseBackend(document["config"]["physicsBackend"].GetString());
+  }
+  readOptional(document["config"], "physicsThreadCount", config.physics.threadCount);
+  if (document["config"].HasMember("physicsProfile")) {
+    const auto &profileObject = document["config"]["physicsProfile"];
+    auto &profile = config.physics.profile;
+    if (profileObject.HasMember("broadphase")) {
+      profile.broadphase = PhysicsEnv::parseBroadphase(profileObject["broadphase"].GetString());
+    }
+    if (profileObject.HasMember("solver")) {
+      profile.solver = PhysicsEnv::parseSolver(profileObject["solver"].GetString());
+    }
+    readOptional(profileObject, "solverIterations", profile.solverIterations);
+    readOptional(profileObject, "splitImpulse", profile.splitImpulse);
+    readOptional(profileObject, "warmstartingFactor", profile.warmstartingFactor);
+    config.physics.profileOverride = true;
+  }
+  if (config.environmentCount < 1) {
+    std::cerr << "Invalid environment count" << std::endl;
+    return 1;
+  }
+  if (config.workerCount < 0) {
+    std::cerr << "Invalid worker count" << std::endl;
+    return 1;
+  }
+  if (config.asyncLearner && (config.workerCount == 0)) {
+    std::cerr << "Asynchronous learner requires workers" << std::endl;
+    return 1;
+  }
+  if (config.physics.threadCount < 0) {
+    std::cerr << "Invalid physics thread count" << std::endl;
+    return 1;
+  }
+  if (config.publishInterval < 1) {
+    std::cerr << "Invalid publish interval" << std::endl;
+    return 1;
+  }
 
   std::filesystem::path outputFileName = inputFilePath.stem();
   outputFileName += "_out";
   outputFileName += inputFilePath.extension();
   auto outputFilePath = inputFilePath;
   outputFilePath.replace_filename(outputFileName);
+  auto stateDirectoryPath = outputFilePath;
+  stateDirectoryPath.replace_filename(outputFilePath.stem().string() + "_state");
+  auto checkpointFileName = outputFileName;
+  checkpointFileName.replace_extension(".ckpt");
+  auto checkpointFilePath = inputFilePath;
+  checkpointFilePath.replace_filename(checkpointFileName);
 
   const String shapeData = document["shapeData"].GetString();
 
-  const auto environment = std::make_shared<TwistyEnv>(shapeData);
+  if (autotune) {
+    PhysicsAutotuner autotuner(shapeData, config.physics, autotuneTolerance, autotuneStepCount);
+    autotuner.run();
+    std::cout << "Physics profiles: step(us) jointError stable" << std::endl;
+    for (const auto &result : autotuner.results) {
+      std::cout << "  " << PhysicsEnv::formatProfile(result.profile)
+                << ": " << result.stepTime
+                << " " << result.jointError
+                << " " << result.stable << std::endl;
+    }
+    const auto *best = autotuner.best();
+    if (best == nullptr) {
+      std::cerr << "No stable physics profile" << std::endl;
+      return 1;
+    }
+    std::cout << "Best physics profile: f " << PhysicsEnv::formatProfile(best->profile) << std::endl;
+    return 0;
+  }
+
+  Array<VectorEnvironmentPtr> environments;
+  for (int i = 0; i < std::max(config.workerCount, 1); i++) {
+    Array<EnvironmentPtr> workerEnvironments;
+    for (int j = 0; j < config.environmentCount; j++) {
+      auto environment = std::make_shared<TwistyEnv>(shapeData, config.physics);
+      if ((i == 0) && (j == 0)) {
+        const auto linkCount = environment->links.size();
+        std::cout << "Link pairs pruned: " << environment->shape->linkPairFilter->excludedCount()
+                  << "/" << linkCount * (linkCount - 1) / 2 << std::endl;
+      }
+      workerEnvironments.push_back(environment);
+    }
+    environments.push_back(std::make_shared<VectorEnvironment>(workerEnvironments));
+  }
 
-  const auto observationLength = environment->observation.size();
-  if ((observationLength == 0) || (environment->actionLength == 0)) {
+  const auto observationLength = environments.front()->observationLength;
+  const auto actionLength = environments.front()->actionLength;
+  if ((observationLength == 0) || (actionLength == 0)) {
     return 1;
   }
 
-  const auto network = std::make_shared<Network>(config, observationLength, environment->actionLength);
+  const auto network = std::make_shared<Network>(config, observationLength, actionLength);
 
-  if (!document["checkpoint"]["data"].IsNull()) {
+  if (document["checkpoint"].HasMember("file") && document["checkpoint"]["file"].IsString()) {
+    auto inputCheckpointFilePath = inputFilePath;
+    inputCheckpointFilePath.replace_filename(document["checkpoint"]["file"].GetString());
+    const MappedFile checkpointFile(inputCheckpointFilePath.string());
+    network->load(checkpointFile.data(), checkpointFile.size());
+    std::cout << "Load checkpoint" << std::endl;
+  } else if (document["checkpoint"].HasMember("data") && !document["checkpoint"]["data"].IsNull()) {
     const String checkpointData(document["checkpoint"]["data"].GetString(),
                                 document["checkpoint"]["data"].GetStringLength());
     network->load(checkpointData);
     std::cout << "Load checkpoint" << std::endl;
   }
 
-  Coach coach(config, environment, network);
+  TrainingState state(stateDirectoryPath.string());
+  const auto resume = saveState && state.exists();
+  if (resume) {
+    state.read();
+    // Workers count their own steps from zero, so the random phase already played is skipped
+    if (config.workerCount > 0) {
+      config.randomSteps = std::max(config.randomSteps - static_cast<int>(state.advance), 0);
+    }
+  }
+
+  const auto coach = (config.workerCount > 0
+                      ? std::make_shared<Coach>(config, environments, network)
+                      : std::make_shared<Coach>(config, environments.front(), network));
+  if (resume) {
+    state.restore(*coach);
+    std::cout << "Resume training state" << std::endl;
+  }
+  if (config.asyncLearner) {
+    coach->startLearner(trainingStartSteps);
+  }
+
+  auto &allocator = document.GetAllocator();
+  if (!document["checkpoint"].HasMember("file")) {
+    document["checkpoint"].AddMember("file", rapidjson::Value(), allocator);
+  }
+  if (!document["checkpoint"].HasMember("data")) {
+    document["checkpoint"].AddMember("data", rapidjson::Value(), allocator);
+  } else {
+    // Only the output copies carry the data, so the loaded one is not copied every epoch
+    document["checkpoint"]["data"].SetNull();
+  }
+  CheckpointWriter checkpointWriter;
+
+  TrainStatistics trainStatistics;
 
-  int playGameCount = 0;
-  int playMoveCount = 0;
-  float playCurrentValue = 0;
-  float playTotalValue = 0;
-  int trainTime = 0;
-  int trainStepCount = 0;
-  ActorCriticLosses trainLosses = {0, 0};
+  Profiler::TraceFile traceFile;
+  if (!traceFilePath.empty()) {
+    traceFile.open(traceFilePath);
+  }
 
   const auto startRunTime = std::chrono::steady_clock::now();
   auto startEpochTime = startRunTime;
 
-  for (int t = 0; t < totalSteps; t++) {
-    const auto reward = coach.step();
-    playCurrentValue += reward;
-    playMoveCount++;
+  int t = (resume ? state.step : 0);
+  int trainingStep = (resume ? state.trainingStep : trainingStartSteps);
+  int epochStep = (resume ? state.epochStep : epochSteps);
+  while (t < totalSteps) {
+    t += coach->step();
 
-    if (environment->done || environment->timeout()) {
-      playGameCount++;
-      playTotalValue += playCurrentValue;
-      playCurrentValue = 0;
-    }
-
-    if ((t >= trainingStartSteps) && ((t % trainingInterval) == 0)) {
+    while ((coach->learner == nullptr) && (t > trainingStep)) {
       const auto startTrainTime = std::chrono::steady_clock::now();
       for (int i = 0; i < trainingInterval; i++) {
-        const auto losses = coach.train();
-        trainLosses.first += losses.first;
-        trainLosses.second += losses.second;
-        trainStepCount++;
+        const auto losses = coach->train();
+        trainStatistics.losses.first += losses.first;
+        trainStatistics.losses.second += losses.second;
+        trainStatistics.stepCount++;
       }
-      trainTime += std::chrono::duration_cast<std::chrono::milliseconds>
-                   (std::chrono::steady_clock::now() - startTrainTime).count();
+      trainStatistics.time += std::chrono::duration_cast<std::chrono::microseconds>
+                              (std::chrono::steady_clock::now() - startTrainTime).count();
+      trainingStep += trainingInterval;
     }
 
-    if (((t + 1) % epochSteps == 0)) {
-      const auto epochNumber = (t + 1) / epochSteps;
+    if (t >= epochStep) {
+      const auto epochNumber = epochStep / epochSteps;
+      epochStep += epochSteps;
+
+      if (coach->learner != nullptr) {
+        const auto learnerStatistics = coach->learner->collectStatistics();
+        trainStatistics.stepCount += learnerStatistics.stepCount;
+        trainStatistics.losses.first += learnerStatistics.losses.first;
+        trainStatistics.losses.second += learnerStatistics.losses.second;
+        trainStatistics.time += learnerStatistics.time;
+      }
 
-      const auto checkpointData = network->save();
+      std::ostringstream checkpointStream;
+      {
+        const auto lock = coach->lockNetwork();
+        network->save(checkpointStream);
+        if (saveState) {
+          state.step = t;
+          state.trainingStep = trainingStep;
+          state.epochStep = epochStep;
+          state.save(*coach, checkpointWriter);
+        }
+      }
+      auto checkpointData = checkpointStream.str();
+      checkpointWriter.submit(checkpointFilePath.string(), checkpointData);
       const auto checkpointTime = std::chrono::duration_cast<std::chrono::milliseconds>
                                   (std::chrono::system_clock::now().time_since_epoch()).count();
-      document["checkpoint"]["data"].SetString(checkpointData, document.GetAllocator());
+      document["checkpoint"]["file"].SetString(checkpointFileName.string(), allocator);
       document["checkpoint"]["time"].SetInt64(checkpointTime);
-      saveDocument(document, outputFilePath.string());
+      // The editor imports the inline data, which is encoded on the writer thread
+      auto outputDocument = std::make_shared<rapidjson::Document>();
+      outputDocument->CopyFrom(document, outputDocument->GetAllocator());
+      checkpointWriter.submit(outputFilePath.string(),
+                              [outputDocument, checkpointData = std::move(checkpointData)]() {
+        (*outputDocument)["checkpoint"]["data"].SetString(macaron::Base64::Encode(checkpointData),
+                                                         outputDocument->GetAllocator());
+        return writeDocument(*outputDocument);
+      });
 
       const auto currentTime = std::chrono::steady_clock::now();
       const auto epochTime = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -177,23 +410,33 @@ int main(int argc, char* argv[]) {
 
       std::cout << std::endl;
       std::cout << "Epoch " << epochNumber << std::endl;
-      std::cout << "Games     : " << playGameCount << std::endl;
-      std::cout << "Moves     : " << (playGameCount > 0 ? playMoveCount / playGameCount : playMoveCount) << std::endl;
-      std::cout << "Value     : " << (playGameCount > 0 ? playTotalValue / playGameCount : playTotalValue) << std::endl;
+      const auto &statistics = coach->statistics;
+      std::cout << "Games     : " << statistics.gameCount << std::endl;
+      std::cout << "Moves     : " << (statistics.gameCount > 0 ? statistics.moveCount / statistics.gameCount : statistics.moveCount) << std::endl;
+      std::cout << "Value     : " << (statistics.gameCount > 0 ? statistics.totalValue / statistics.gameCount : statistics.totalValue) << std::endl;
+      const auto trainStepCount = trainStatistics.stepCount;
+      const auto &trainLosses = trainStatistics.losses;
+      const auto trainTime = trainStatistics.time / 1000;
       std::cout << "LossP     : " << (trainStepCount > 0 ? trainLosses.first / trainStepCount : trainLosses.first) << std::endl;
       std::cout << "LossV     : " << (trainStepCount > 0 ? trainLosses.second / trainStepCount : trainLosses.second) << std::endl;
-      std::cout << "PlayTime  : " << epochTime - trainTime << std::endl;
+      std::cout << "PlayTime  : " << (coach->learner != nullptr ? epochTime : epochTime - trainTime) << std::endl;
       std::cout << "TrainTime : " << trainTime << std::endl;
       std::cout << "EpochTime : " << epochTime << std::endl;
       std::cout << "TotalTime : " << totalTime / 60 << ":" << std::setfill('0') << std::setw(2) << totalTime % 60 << std::endl;
 
-      playGameCount = 0;
-      playMoveCount = 0;
-      playCurrentValue = 0;
-      playTotalValue = 0;
-      trainTime = 0;
-      trainStepCount = 0;
-      trainLosses = {0, 0};
+      if (profile) {
+        const auto events = Profiler::instance().drain();
+        printProfile(events);
+        if (traceFile.isOpen()) {
+          traceFile.write(events);
+          if (epochNumber >= traceEpochs) {
+            traceFile.close();
+          }
+        }
+      }
+
+      coach->statistics = {};
+      trainStatistics = {};
     }
   }
 }
@@ -0,0 +1,79 @@
+
+#include "TransitionQueue.h"
+#include "ReplayBuffer.h"
+
+#include <algorithm>
+
+TransitionQueue::TransitionQueue(int capacity, int observationLength, int actionLength)
+    : capacity(capacity)
+    , observationLength(observationLength)
+    , actionLength(actionLength)
+    , stride(2 * observationLength + actionLength + 3)
+    , records(static_cast<size_t>(capacity) * stride)
+    , sequences(capacity)
+    , enqueuePosition(0)
+    , dequeuePosition(0) {
+  if ((capacity < 2) || ((capacity & (capacity - 1)) != 0)) {
+    EXCEPT("Transition queue capacity must be a power of two");
+  }
+  for (int i = 0; i < capacity; i++) {
+    sequences[i].store(i, std::memory_order_relaxed);
+  }
+}
+
+bool TransitionQueue::push(int stream, const float *observation, const float *action, float reward,
+                           const float *nextObservation, bool done) {
+  const size_t mask = capacity - 1;
+  auto position = enqueuePosition.load(std::memory_order_relaxed);
+  while (true) {
+    const auto sequence = sequences[position & mask].load(std::memory_order_acquire);
+    const auto difference = static_cast<std::ptrdiff_t>(sequence) -
+                            static_cast<std::ptrdiff_t>(position);
+    if (difference == 0) {
+      if (enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  auto *record = &records[(position & mask) * stride];
+  *record++ = static_cast<float>(stream);
+  record = std::copy_n(observation, observationLength, record);
+  record = std::copy_n(action, actionLength, record);
+  *record++ = reward;
+  record = std::copy_n(nextObservation, observationLength, record);
+  *record = (done ? 1 : 0);
+
+  sequences[position & mask].store(position + 1, std::memory_order_release);
+  return true;
+}
+
+int TransitionQueue::drain(ReplayBuffer &replayBuffer, int countMax) {
+  const size_t mask = capacity - 1;
+  int count = 0;
+  while (count < countMax) {
+    auto &sequence = sequences[dequeuePosition & mask];
+    if (sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+      break;
+    }
+
+    const auto *record = &records[(dequeuePosition & mask) * stride];
+    const auto stream = static_cast<int>(record[0]);
+    const auto *observation = record + 1;
+    const auto *action = observation + observationLength;
+    const auto reward = action[actionLength];
+    const auto *nextObservation = action + actionLength + 1;
+    const auto done = (nextObservation[observationLength] != 0);
+    replayBuffer.append(stream, observation, action, reward, nextObservation, done);
+
+    sequence.store(dequeuePosition + capacity, std::memory_order_release);
+    dequeuePosition++;
+    count++;
+  }
+  return count;
+}
@@ -0,0 +1,28 @@
+
+#ifndef TRANSITIONQUEUE_H
+#define TRANSITIONQUEUE_H
+
+#include "Types.h"
+
+#include <atomic>
+
+class TransitionQueue {
+public:
+  TransitionQueue(int capacity, int observationLength, int actionLength);
+  TransitionQueue(const TransitionQueue &queue) = delete;
+
+  bool push(int stream, const float *observation, const float *action, float reward,
+            const float *nextObservation, bool done);
+  int drain(ReplayBuffer &replayBuffer, int countMax);
+
+  int capacity;
+  int observationLength;
+  int actionLength;
+  int stride;
+  Array<float> records;
+  Array<std::atomic<size_t>> sequences;
+  alignas(64) std::atomic<size_t> enqueuePosition;
+  alignas(64) size_t dequeuePosition;
+};
+
+#endif // TRANSITIONQUEUE_H
@@ -15,12 +15,20 @@
 #include <chrono>
 
 class Environment;
+class VectorEnvironment;
 class Actor;
 class Critic;
 class Model;
 class Network;
 class ReplayBuffer;
+class ReplayStorage;
+class SumTree;
 class Coach;
+class ActorSnapshot;
+class ActorWorker;
+class Learner;
+class TransitionQueue;
+struct Batch;
 
 template<typename K, typename V> using Map = std::map<K, V>;
 template<typename T> using Array = std::vector<T>;
@@ -38,18 +46,63 @@ typedef std::mt19937 RandomGenerator;
 
 typedef std::pair<float, float> ActorCriticLosses;
 
-typedef std::tuple<Observation, Action, float, Observation, bool> Sample;
-typedef std::shared_ptr<Sample> SamplePtr;
-typedef Array<SamplePtr> SamplePtrs;
+enum class ObservationFormat {
+  Float32,
+  Float16,
+  BFloat16
+};
+
+enum class ActionFormat {
+  Float32,
+  Int16,
+  Int8
+};
+
+enum class PhysicsBackend {
+  RigidBody,
+  MultiBody
+};
+
+enum class PhysicsBroadphase {
+  Dbvt,
+  AxisSweep,
+  BruteForce
+};
+
+enum class PhysicsSolver {
+  SequentialImpulse,
+  NNCG,
+  Dantzig,
+  Lemke
+};
+
+struct PlayStatistics {
+  int gameCount = 0;
+  int moveCount = 0;
+  float totalValue = 0;
+};
+
+struct TrainStatistics {
+  int stepCount = 0;
+  ActorCriticLosses losses = {0, 0};
+  long long time = 0;
+};
 
 typedef std::shared_ptr<Environment> EnvironmentPtr;
+typedef std::shared_ptr<VectorEnvironment> VectorEnvironmentPtr;
 typedef std::shared_ptr<Actor> ActorPtr;
 typedef std::shared_ptr<Critic> CriticPtr;
 typedef std::shared_ptr<Model> ModelPtr;
 typedef std::shared_ptr<Network> NetworkPtr;
 typedef std::shared_ptr<RandomGenerator> RandomGeneratorPtr;
 typedef std::shared_ptr<ReplayBuffer> ReplayBufferPtr;
+typedef std::shared_ptr<ReplayStorage> ReplayStoragePtr;
+typedef std::shared_ptr<SumTree> SumTreePtr;
 typedef std::shared_ptr<Coach> CoachPtr;
+typedef std::shared_ptr<ActorSnapshot> ActorSnapshotPtr;
+typedef std::shared_ptr<ActorWorker> ActorWorkerPtr;
+typedef std::shared_ptr<Learner> LearnerPtr;
+typedef std::shared_ptr<TransitionQueue> TransitionQueuePtr;
 
 #define EXCEPT(message) std::cerr << (message) << std::endl; throw std::runtime_error(message);
 
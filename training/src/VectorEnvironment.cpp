@@ -0,0 +1,76 @@
+
+#include "VectorEnvironment.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+
+VectorEnvironment::VectorEnvironment(const Array<EnvironmentPtr> &environments)
+    : environments(environments)
+    , observationLength(0)
+    , actionLength(0)
+    , reward(0.0, environments.size())
+    , done(environments.size(), false)
+    , finished(environments.size(), true) {
+  if (environments.empty()) {
+    EXCEPT("Environments must be given");
+  }
+  observationLength = environments.front()->observation.size();
+  actionLength = environments.front()->actionLength;
+  for (const auto &environment : environments) {
+    if ((environment->observation.size() != observationLength) ||
+        (environment->actionLength != actionLength)) {
+      EXCEPT("Environments must have the same observation and action lengths");
+    }
+  }
+
+  const auto environmentCount = static_cast<int>(environments.size());
+  observation = torch::zeros({environmentCount, observationLength}, torch::kFloat32);
+  nextObservation = torch::zeros({environmentCount, observationLength}, torch::kFloat32);
+}
+
+int VectorEnvironment::size() const {
+  return static_cast<int>(environments.size());
+}
+
+void VectorEnvironment::restart() {
+  auto *observationData = observation.data_ptr<float>();
+  TaskPool::instance().parallelFor(0, size(), 1, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      auto &environment = environments[i];
+      if (finished[i]) {
+        environment->restart();
+      }
+      std::copy_n(&environment->observation[0], observationLength,
+                  observationData + i * observationLength);
+    }
+  });
+  std::fill(finished.begin(), finished.end(), false);
+}
+
+void VectorEnvironment::step(const torch::Tensor &action) {
+  const auto *actionData = action.data_ptr<float>();
+  auto *nextObservationData = nextObservation.data_ptr<float>();
+  TaskPool::instance().parallelFor(0, size(), 1, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      auto &environment = environments[i];
+      reward[i] = environment->step(Action(actionData + i * actionLength, actionLength));
+      std::copy_n(&environment->observation[0], observationLength,
+                  nextObservationData + i * observationLength);
+    }
+  });
+  // Flags are packed bits, so they are set after the parallel loop.
+  for (int i = 0; i < size(); i++) {
+    done[i] = environments[i]->done;
+    finished[i] = environments[i]->done || environments[i]->timeout();
+  }
+}
+
+torch::Tensor VectorEnvironment::randomAction() {
+  auto action = torch::empty({size(), actionLength}, torch::kFloat32);
+  auto *actionData = action.data_ptr<float>();
+  for (int i = 0; i < size(); i++) {
+    const auto environmentAction = environments[i]->randomAction();
+    std::copy_n(&environmentAction[0], actionLength, actionData + i * actionLength);
+  }
+  return action;
+}
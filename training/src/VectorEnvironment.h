@@ -0,0 +1,30 @@
+
+#ifndef VECTORENVIRONMENT_H
+#define VECTORENVIRONMENT_H
+
+#include "Environment.h"
+#include "Model.h"
+
+class VectorEnvironment {
+public:
+  VectorEnvironment(const Array<EnvironmentPtr> &environments);
+
+  int size() const;
+
+  void restart();
+
+  void step(const torch::Tensor &action);
+
+  torch::Tensor randomAction();
+
+  Array<EnvironmentPtr> environments;
+  int observationLength;
+  int actionLength;
+  torch::Tensor observation;
+  torch::Tensor nextObservation;
+  FloatValArray reward;
+  Array<bool> done;
+  Array<bool> finished;
+};
+
+#endif // VECTORENVIRONMENT_H